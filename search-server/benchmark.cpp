@@ -0,0 +1,422 @@
+// Benchmarks of the search server on generated corpora. Every corpus size is
+// indexed, also from a corpus file, queried and pruned with sequential and
+// parallel policies, and the throughput, latency percentiles and memory of
+// each step go to a JSON file:
+//
+//     search_server_benchmark --sizes 10000,100000 --output results.json
+//
+// The corpus depends only on the options, so results of two commits built
+// the same way compare directly.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "corpus_generator.h"
+#include "corpus_loader.h"
+#include "latency_histogram.h"
+#include "process_queries.h"
+#include "profiler.h"
+#include "remove_duplicates.h"
+#include "search_server.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchmarkOptions {
+    CorpusGeneratorOptions corpus;
+    std::vector<size_t> document_counts = { 10000, 100000 };
+    size_t query_count = 2000;
+    // Documents removed one by one with each policy, at most
+    size_t removal_count = 1000;
+    // Free text stored with the results, such as the commit benchmarked
+    std::string label;
+    std::string output_path = "benchmark.json";
+};
+
+struct Measurement {
+    std::string name;
+    std::string policy;
+    size_t operation_count = 0;
+    std::chrono::nanoseconds duration{0};
+    // Empty when operations were only timed together
+    LatencyHistogram latencies;
+    // Input read per second; 0 when the step reads no file
+    double megabytes_per_second = 0.0;
+};
+
+struct RunResult {
+    size_t document_count = 0;
+    // Resident memory the index took, documents added one by one
+    int64_t index_bytes = 0;
+    size_t duplicate_count = 0;
+    std::vector<Measurement> measurements;
+};
+
+int64_t GetResidentBytes() {
+    long total_pages = 0;
+    long resident_pages = 0;
+    if (FILE* file = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(file, "%ld %ld", &total_pages, &resident_pages) != 2) {
+            resident_pages = 0;
+        }
+        std::fclose(file);
+    }
+    return static_cast<int64_t>(resident_pages) * sysconf(_SC_PAGESIZE);
+}
+
+int64_t GetPeakResidentBytes() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    // Kilobytes on Linux
+    return static_cast<int64_t>(usage.ru_maxrss) * 1024;
+}
+
+Measurement MakeMeasurement(std::string name, std::string policy, size_t count) {
+    Measurement measurement;
+    measurement.name = std::move(name);
+    measurement.policy = std::move(policy);
+    measurement.operation_count = count;
+    return measurement;
+}
+
+// Times every call of operation(i) for i in [0, count)
+template <typename Operation>
+Measurement MeasureEach(std::string name, std::string policy, size_t count, Operation operation) {
+    Measurement measurement = MakeMeasurement(std::move(name), std::move(policy), count);
+    const auto start_time = Clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        const auto operation_start_time = Clock::now();
+        operation(i);
+        measurement.latencies.Add(Clock::now() - operation_start_time);
+    }
+    measurement.duration = Clock::now() - start_time;
+    return measurement;
+}
+
+// Times one call of operation() that performs count operations
+template <typename Operation>
+Measurement MeasureTotal(std::string name, std::string policy, size_t count, Operation operation) {
+    Measurement measurement = MakeMeasurement(std::move(name), std::move(policy), count);
+    const auto start_time = Clock::now();
+    operation();
+    measurement.duration = Clock::now() - start_time;
+    return measurement;
+}
+
+const char* GetStatusName(DocumentStatus status) {
+    switch (status) {
+    case DocumentStatus::ACTUAL:
+        return "ACTUAL";
+    case DocumentStatus::IRRELEVANT:
+        return "IRRELEVANT";
+    case DocumentStatus::BANNED:
+        return "BANNED";
+    case DocumentStatus::REMOVED:
+        return "REMOVED";
+    }
+    return "";
+}
+
+// Writes the documents in the format LoadCorpus reads
+void WriteCorpusFile(const std::string& path, const std::vector<GeneratedDocument>& documents) {
+    std::ofstream output(path, std::ios::binary);
+    for (const GeneratedDocument& document : documents) {
+        output << document.id << '\t' << GetStatusName(document.status) << '\t';
+        for (size_t i = 0; i < document.ratings.size(); ++i) {
+            output << (i == 0 ? "" : " ") << document.ratings[i];
+        }
+        output << '\t' << document.text << '\n';
+    }
+    if (!output) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+std::vector<DocumentToAdd> MakeBatch(const std::vector<GeneratedDocument>& documents) {
+    std::vector<DocumentToAdd> batch;
+    batch.reserve(documents.size());
+    for (const GeneratedDocument& document : documents) {
+        batch.push_back({ document.id, document.text, document.status, document.ratings });
+    }
+    return batch;
+}
+
+RunResult RunBenchmark(const BenchmarkOptions& options, size_t document_count) {
+    CorpusGenerator generator(options.corpus);
+    const std::vector<GeneratedDocument> documents = generator.GenerateDocuments(document_count);
+    const std::vector<std::string> queries = generator.GenerateQueries(options.query_count);
+    const std::vector<DocumentToAdd> batch = MakeBatch(documents);
+
+    RunResult result;
+    result.document_count = document_count;
+    std::vector<Measurement>& measurements = result.measurements;
+
+    SearchServer server(generator.GetStopWords());
+    const int64_t resident_bytes = GetResidentBytes();
+    measurements.push_back(MeasureEach("add_document", "seq", document_count, [&](size_t i) {
+        const GeneratedDocument& document = documents[i];
+        server.AddDocument(document.id, document.text, document.status, document.ratings);
+    }));
+    result.index_bytes = GetResidentBytes() - resident_bytes;
+
+    for (const bool parallel : { false, true }) {
+        SearchServer batch_server(generator.GetStopWords());
+        measurements.push_back(MeasureTotal("add_documents", parallel ? "par" : "seq", document_count, [&] {
+            if (parallel) {
+                batch_server.AddDocuments(std::execution::par, batch);
+            } else {
+                batch_server.AddDocuments(std::execution::seq, batch);
+            }
+        }));
+    }
+
+    const std::string corpus_path = (std::filesystem::temp_directory_path()
+        / ("search_server_benchmark_" + std::to_string(getpid()) + ".tsv")).string();
+    WriteCorpusFile(corpus_path, documents);
+    {
+        SearchServer loaded_server(generator.GetStopWords());
+        CorpusLoadResult load_result;
+        measurements.push_back(MeasureTotal("load_corpus", "par", document_count, [&] {
+            load_result = LoadCorpus(loaded_server, corpus_path);
+        }));
+        measurements.back().megabytes_per_second = load_result.GetMegabytesPerSecond();
+    }
+    std::filesystem::remove(corpus_path);
+
+    size_t found_count = 0;
+    measurements.push_back(MeasureEach("find_top_documents", "seq", queries.size(), [&](size_t i) {
+        found_count += server.FindTopDocuments(std::execution::seq, queries[i]).size();
+    }));
+    measurements.push_back(MeasureEach("find_top_documents", "par", queries.size(), [&](size_t i) {
+        found_count += server.FindTopDocuments(std::execution::par, queries[i]).size();
+    }));
+
+    // Documents spread over the whole corpus, a different one for every query
+    const auto match_document_id = [&](size_t i) {
+        return documents[i * 7919 % documents.size()].id;
+    };
+    size_t matched_count = 0;
+    measurements.push_back(MeasureEach("match_document", "seq", queries.size(), [&](size_t i) {
+        matched_count += std::get<0>(server.MatchDocument(std::execution::seq, queries[i], match_document_id(i))).size();
+    }));
+    measurements.push_back(MeasureEach("match_document", "par", queries.size(), [&](size_t i) {
+        matched_count += std::get<0>(server.MatchDocument(std::execution::par, queries[i], match_document_id(i))).size();
+    }));
+
+    measurements.push_back(MeasureTotal("process_queries", "par", queries.size(), [&] {
+        found_count += ProcessQueries(server, queries).size();
+    }));
+    measurements.push_back(MeasureTotal("process_queries_joined", "par", queries.size(), [&] {
+        ProcessQueriesJoined(server, queries, [&found_count](const Document&) {
+            ++found_count;
+        });
+    }));
+
+    // The first documents go one by one, then RemoveDuplicates prunes the rest
+    const size_t removal_count = std::min(options.removal_count, documents.size() / 4);
+    measurements.push_back(MeasureEach("remove_document", "seq", removal_count, [&](size_t i) {
+        server.RemoveDocument(std::execution::seq, documents[i].id);
+    }));
+    measurements.push_back(MeasureEach("remove_document", "par", removal_count, [&](size_t i) {
+        server.RemoveDocument(std::execution::par, documents[removal_count + i].id);
+    }));
+
+    measurements.push_back(MeasureTotal("remove_duplicates", "par", static_cast<size_t>(server.GetDocumentCount()), [&] {
+        result.duplicate_count = RemoveDuplicates(server).size();
+    }));
+
+    // Keeps the results alive, so no search is optimized away
+    std::cerr << document_count << " documents: " << found_count << " found, " << matched_count << " matched, "
+              << result.duplicate_count << " duplicates" << std::endl;
+    return result;
+}
+
+std::string EscapeJson(const std::string& text) {
+    std::string result;
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        }
+        if (static_cast<unsigned char>(c) >= 0x20) {
+            result += c;
+        }
+    }
+    return result;
+}
+
+void WriteMeasurement(std::ostream& output, const Measurement& measurement) {
+    const double seconds = std::chrono::duration<double>(measurement.duration).count();
+    output << "{\"name\":\"" << measurement.name << "\""
+           << ",\"policy\":\"" << measurement.policy << "\""
+           << ",\"operations\":" << measurement.operation_count
+           << ",\"seconds\":" << seconds
+           << ",\"operations_per_second\":" << (seconds > 0.0 ? measurement.operation_count / seconds : 0.0);
+    if (measurement.megabytes_per_second > 0.0) {
+        output << ",\"megabytes_per_second\":" << measurement.megabytes_per_second;
+    }
+    if (measurement.latencies.GetCount() > 0) {
+        output << ",\"p50_ns\":" << measurement.latencies.GetPercentile(0.50).count()
+               << ",\"p95_ns\":" << measurement.latencies.GetPercentile(0.95).count()
+               << ",\"p99_ns\":" << measurement.latencies.GetPercentile(0.99).count()
+               << ",\"max_ns\":" << measurement.latencies.GetMax().count();
+    }
+    output << '}';
+}
+
+void WriteResults(std::ostream& output, const BenchmarkOptions& options, const std::vector<RunResult>& runs) {
+    const CorpusGeneratorOptions& corpus = options.corpus;
+    output << "{\"label\":\"" << EscapeJson(options.label) << "\""
+           << ",\"config\":{"
+           << "\"seed\":" << corpus.seed
+           << ",\"vocabulary_size\":" << corpus.vocabulary_size
+           << ",\"zipf_exponent\":" << corpus.zipf_exponent
+           << ",\"min_document_length\":" << corpus.min_document_length
+           << ",\"max_document_length\":" << corpus.max_document_length
+           << ",\"stop_word_count\":" << corpus.stop_word_count
+           << ",\"duplicate_ratio\":" << corpus.duplicate_ratio
+           << ",\"min_query_length\":" << corpus.min_query_length
+           << ",\"max_query_length\":" << corpus.max_query_length
+           << ",\"minus_word_ratio\":" << corpus.minus_word_ratio
+           << ",\"query_count\":" << options.query_count
+           << ",\"hardware_threads\":" << std::thread::hardware_concurrency()
+           << "},\"runs\":[";
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const RunResult& run = runs[i];
+        output << (i == 0 ? "" : ",")
+               << "{\"documents\":" << run.document_count
+               << ",\"index_bytes\":" << run.index_bytes
+               << ",\"duplicates\":" << run.duplicate_count
+               << ",\"measurements\":[";
+        for (size_t j = 0; j < run.measurements.size(); ++j) {
+            output << (j == 0 ? "" : ",");
+            WriteMeasurement(output, run.measurements[j]);
+        }
+        output << "]}";
+    }
+    output << "],\"peak_resident_bytes\":" << GetPeakResidentBytes();
+#ifdef SEARCH_SERVER_PROFILING
+    output << ",\"profile\":";
+    WriteProfile(output);
+#endif
+    output << "}\n";
+}
+
+std::vector<size_t> ParseSizes(const std::string& text) {
+    std::vector<size_t> sizes;
+    std::istringstream input(text);
+    for (std::string size; std::getline(input, size, ',');) {
+        sizes.push_back(std::stoull(size));
+    }
+    return sizes;
+}
+
+const char USAGE[] =
+    "Usage: search_server_benchmark [options]\n"
+    "  --sizes N,N,...       documents of each corpus (10000,100000)\n"
+    "  --queries N           queries per corpus (2000)\n"
+    "  --removals N          documents removed one by one per policy (1000)\n"
+    "  --vocabulary N        distinct words (50000)\n"
+    "  --zipf S              exponent of the word distribution (1.0)\n"
+    "  --min-length N        words per document, at least (20)\n"
+    "  --max-length N        words per document, at most (50)\n"
+    "  --stop-words N        most frequent words treated as stop words (10)\n"
+    "  --duplicates R        share of duplicate documents (0.01)\n"
+    "  --min-query-length N  plus words per query, at least (1)\n"
+    "  --max-query-length N  plus words per query, at most (4)\n"
+    "  --minus-ratio R       share of queries with a minus word (0.25)\n"
+    "  --seed N              generator seed (42)\n"
+    "  --label TEXT          stored with the results, such as a commit id\n"
+    "  --output PATH         JSON results (benchmark.json)\n";
+
+BenchmarkOptions ParseOptions(int argc, char** argv) {
+    BenchmarkOptions options;
+    CorpusGeneratorOptions& corpus = options.corpus;
+    for (int i = 1; i < argc; ++i) {
+        const std::string name = argv[i];
+        if (i + 1 == argc) {
+            throw std::invalid_argument("Missing value of " + name);
+        }
+        const std::string value = argv[++i];
+        if (name == "--sizes") {
+            options.document_counts = ParseSizes(value);
+        } else if (name == "--queries") {
+            options.query_count = std::stoull(value);
+        } else if (name == "--removals") {
+            options.removal_count = std::stoull(value);
+        } else if (name == "--vocabulary") {
+            corpus.vocabulary_size = std::stoull(value);
+        } else if (name == "--zipf") {
+            corpus.zipf_exponent = std::stod(value);
+        } else if (name == "--min-length") {
+            corpus.min_document_length = std::stoull(value);
+        } else if (name == "--max-length") {
+            corpus.max_document_length = std::stoull(value);
+        } else if (name == "--stop-words") {
+            corpus.stop_word_count = std::stoull(value);
+        } else if (name == "--duplicates") {
+            corpus.duplicate_ratio = std::stod(value);
+        } else if (name == "--min-query-length") {
+            corpus.min_query_length = std::stoull(value);
+        } else if (name == "--max-query-length") {
+            corpus.max_query_length = std::stoull(value);
+        } else if (name == "--minus-ratio") {
+            corpus.minus_word_ratio = std::stod(value);
+        } else if (name == "--seed") {
+            corpus.seed = std::stoull(value);
+        } else if (name == "--label") {
+            options.label = value;
+        } else if (name == "--output") {
+            options.output_path = value;
+        } else {
+            throw std::invalid_argument("Unknown option " + name);
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 2 && std::string(argv[1]) == "--help") {
+        std::cout << USAGE;
+        return 0;
+    }
+    BenchmarkOptions options;
+    try {
+        options = ParseOptions(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n' << USAGE;
+        return 1;
+    }
+
+    std::vector<RunResult> runs;
+    try {
+        for (const size_t document_count : options.document_counts) {
+            runs.push_back(RunBenchmark(options, document_count));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Benchmark failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::ofstream output(options.output_path);
+    WriteResults(output, options, runs);
+    if (!output) {
+        std::cerr << "Cannot write " << options.output_path << std::endl;
+        return 1;
+    }
+    return 0;
+}
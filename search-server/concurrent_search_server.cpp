@@ -0,0 +1,59 @@
+#include "concurrent_search_server.h"
+
+void ConcurrentSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    Write([&](SearchServer& server) {
+        server.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+std::vector<RejectedDocument> ConcurrentSearchServer::AddDocuments(const std::vector<DocumentToAdd>& documents) {
+    return Write([&](SearchServer& server) {
+        return server.AddDocuments(std::execution::par, documents);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    Write([document_id](SearchServer& server) {
+        server.RemoveDocument(document_id);
+    });
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    Write([&](SearchServer& server) {
+        server.RemoveDocuments(document_ids);
+    });
+}
+
+void ConcurrentSearchServer::Compact() {
+    Write([](SearchServer& server) {
+        server.Compact();
+    });
+}
+
+void ConcurrentSearchServer::SetMaxResultDocumentCount(size_t count) {
+    Write([count](SearchServer& server) {
+        server.SetMaxResultDocumentCount(count);
+    });
+}
+
+void ConcurrentSearchServer::SetRetrievalMode(RetrievalMode mode) {
+    Write([mode](SearchServer& server) {
+        server.SetRetrievalMode(mode);
+    });
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return Read([](const SearchServer& server) {
+        return server.GetDocumentCount();
+    });
+}
+
+std::string ConcurrentSearchServer::GetDocumentText(int document_id) const {
+    return Read([document_id](const SearchServer& server) {
+        return std::string(server.GetDocumentText(document_id));
+    });
+}
+
+uint64_t ConcurrentSearchServer::GetVersion() const {
+    return version_.load();
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "search_server.h"
+
+// SearchServer that any number of threads can query while another thread adds
+// and removes documents. Readers never wait for writers.
+//
+// Two copies of the index are kept (the left-right technique). Readers use the
+// active copy. A write is applied to the standby copy, which is then published
+// as the active one; the write is replayed on the old copy once the readers that
+// were still using it are done. Every read sees the index right after some
+// complete write, and a copy is only changed when no reader holds it.
+class ConcurrentSearchServer {
+public:
+    template <typename StopWords>
+    explicit ConcurrentSearchServer(const StopWords& stop_words);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    std::vector<RejectedDocument> AddDocuments(const std::vector<DocumentToAdd>& documents);
+    void RemoveDocument(int document_id);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    void Compact();
+
+    void SetMaxResultDocumentCount(size_t count);
+    void SetRetrievalMode(RetrievalMode mode);
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const;
+
+    // Matched words point into term storage that lives as long as this server
+    template <typename... Args>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(Args&&... args) const;
+
+    int GetDocumentCount() const;
+    std::string GetDocumentText(int document_id) const;
+
+    // Number of writes published so far
+    uint64_t GetVersion() const;
+
+    // Calls function(const SearchServer&) on one version of the index, so several
+    // lookups can agree with each other. The reference must not escape the call.
+    template <typename Function>
+    auto Read(Function function) const;
+
+private:
+    SearchServer instances_[2];
+    // Index of the copy new readers use
+    std::atomic<size_t> active_{0};
+    // Readers currently using each copy
+    mutable std::atomic<int> readers_[2] = {};
+    std::atomic<uint64_t> version_{0};
+    std::mutex write_mutex_;
+
+    // Applies operation(SearchServer&) to both copies. If it throws on the
+    // first one nothing is published; it must not throw on the replay.
+    template <typename Operation>
+    auto Write(Operation operation);
+};
+
+template <typename StopWords>
+ConcurrentSearchServer::ConcurrentSearchServer(const StopWords& stop_words)
+    : instances_{ SearchServer(stop_words), SearchServer(stop_words) }
+{
+}
+
+template <typename... Args>
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(Args&&... args) const {
+    return Read([&](const SearchServer& server) {
+        return server.FindTopDocuments(std::forward<Args>(args)...);
+    });
+}
+
+template <typename... Args>
+std::tuple<std::vector<std::string_view>, DocumentStatus> ConcurrentSearchServer::MatchDocument(Args&&... args) const {
+    return Read([&](const SearchServer& server) {
+        return server.MatchDocument(std::forward<Args>(args)...);
+    });
+}
+
+template <typename Function>
+auto ConcurrentSearchServer::Read(Function function) const {
+    size_t instance = active_.load();
+    while (true) {
+        readers_[instance].fetch_add(1);
+        // The writer may have switched copies before it could see this reader
+        const size_t active = active_.load();
+        if (active == instance) {
+            break;
+        }
+        readers_[instance].fetch_sub(1);
+        instance = active;
+    }
+
+    struct ReaderGuard {
+        std::atomic<int>& readers;
+        ~ReaderGuard() {
+            readers.fetch_sub(1);
+        }
+    } guard{ readers_[instance] };
+    return function(instances_[instance]);
+}
+
+template <typename Operation>
+auto ConcurrentSearchServer::Write(Operation operation) {
+    std::lock_guard guard(write_mutex_);
+    const size_t active = active_.load();
+    const size_t standby = 1 - active;
+
+    const auto publish = [&] {
+        active_.store(standby);
+        version_.fetch_add(1);
+        while (readers_[active].load() != 0) {
+            std::this_thread::yield();
+        }
+    };
+
+    if constexpr (std::is_void_v<decltype(operation(instances_[standby]))>) {
+        operation(instances_[standby]);
+        publish();
+        operation(instances_[active]);
+    } else {
+        auto result = operation(instances_[standby]);
+        publish();
+        operation(instances_[active]);
+        return result;
+    }
+}
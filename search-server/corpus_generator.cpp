@@ -0,0 +1,133 @@
+#include "corpus_generator.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+// Bijective base 26: a, b, ..., z, aa, ab, ...
+std::string MakeWord(size_t rank) {
+    std::string word;
+    for (size_t value = rank + 1; value > 0; value = (value - 1) / 26) {
+        word += static_cast<char>('a' + (value - 1) % 26);
+    }
+    std::reverse(word.begin(), word.end());
+    return word;
+}
+
+} // namespace
+
+CorpusGenerator::CorpusGenerator(CorpusGeneratorOptions options)
+    : options_(options)
+    , state_(options.seed)
+{
+    if (options_.vocabulary_size == 0) {
+        throw std::invalid_argument("Vocabulary is empty");
+    }
+    if (options_.min_document_length == 0 || options_.min_document_length > options_.max_document_length) {
+        throw std::invalid_argument("Invalid document length range");
+    }
+    if (options_.min_query_length == 0 || options_.min_query_length > options_.max_query_length) {
+        throw std::invalid_argument("Invalid query length range");
+    }
+    words_.reserve(options_.vocabulary_size);
+    cumulative_weights_.reserve(options_.vocabulary_size);
+    double total_weight = 0.0;
+    for (size_t rank = 0; rank < options_.vocabulary_size; ++rank) {
+        words_.push_back(MakeWord(rank));
+        total_weight += 1.0 / std::pow(static_cast<double>(rank + 1), options_.zipf_exponent);
+        cumulative_weights_.push_back(total_weight);
+    }
+}
+
+std::vector<GeneratedDocument> CorpusGenerator::GenerateDocuments(size_t count, int first_id) {
+    const DocumentStatus OTHER_STATUSES[] = { DocumentStatus::IRRELEVANT, DocumentStatus::BANNED, DocumentStatus::REMOVED };
+
+    std::vector<GeneratedDocument> documents;
+    documents.reserve(count);
+    std::vector<std::string_view> words;
+    for (size_t i = 0; i < count; ++i) {
+        words.clear();
+        if (!documents.empty() && NextDouble() < options_.duplicate_ratio) {
+            const std::string& original = documents[NextInRange(0, documents.size() - 1)].text;
+            for (size_t begin = 0; begin < original.size(); ) {
+                const size_t end = std::min(original.find(' ', begin), original.size());
+                words.push_back(std::string_view(original).substr(begin, end - begin));
+                begin = end + 1;
+            }
+            // Fisher-Yates
+            for (size_t j = words.size(); j > 1; --j) {
+                std::swap(words[j - 1], words[NextInRange(0, j - 1)]);
+            }
+        } else {
+            const size_t length = NextInRange(options_.min_document_length, options_.max_document_length);
+            for (size_t j = 0; j < length; ++j) {
+                words.push_back(NextWord());
+            }
+        }
+
+        GeneratedDocument document;
+        document.id = first_id + static_cast<int>(i);
+        for (const std::string_view word : words) {
+            if (!document.text.empty()) {
+                document.text += ' ';
+            }
+            document.text += word;
+        }
+        document.status = NextInRange(0, 19) == 0 ? OTHER_STATUSES[NextInRange(0, 2)] : DocumentStatus::ACTUAL;
+        document.ratings.resize(NextInRange(1, 5));
+        for (int& rating : document.ratings) {
+            rating = static_cast<int>(NextInRange(0, 20)) - 10;
+        }
+        documents.push_back(std::move(document));
+    }
+    return documents;
+}
+
+std::vector<std::string> CorpusGenerator::GenerateQueries(size_t count) {
+    std::vector<std::string> queries;
+    queries.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        std::string query;
+        const size_t length = NextInRange(options_.min_query_length, options_.max_query_length);
+        for (size_t j = 0; j < length; ++j) {
+            if (!query.empty()) {
+                query += ' ';
+            }
+            query += NextWord();
+        }
+        if (NextDouble() < options_.minus_word_ratio) {
+            query += " -";
+            query += NextWord();
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
+
+std::vector<std::string> CorpusGenerator::GetStopWords() const {
+    return std::vector<std::string>(words_.begin(), words_.begin() + std::min(options_.stop_word_count, words_.size()));
+}
+
+uint64_t CorpusGenerator::NextRandom() {
+    uint64_t value = (state_ += 0x9e3779b97f4a7c15ull);
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+double CorpusGenerator::NextDouble() {
+    return static_cast<double>(NextRandom() >> 11) * 0x1.0p-53;
+}
+
+size_t CorpusGenerator::NextInRange(size_t min, size_t max) {
+    // The modulo bias is far below anything a benchmark can notice
+    return min + static_cast<size_t>(NextRandom() % (max - min + 1));
+}
+
+const std::string& CorpusGenerator::NextWord() {
+    const double weight = NextDouble() * cumulative_weights_.back();
+    const auto it = std::upper_bound(cumulative_weights_.begin(), cumulative_weights_.end(), weight);
+    return words_[std::min<size_t>(it - cumulative_weights_.begin(), words_.size() - 1)];
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "document.h"
+
+struct CorpusGeneratorOptions {
+    uint64_t seed = 42;
+    // Distinct words; the word of rank r is drawn with probability proportional to 1 / r^zipf_exponent
+    size_t vocabulary_size = 50000;
+    double zipf_exponent = 1.0;
+    size_t min_document_length = 20;
+    size_t max_document_length = 50;
+    // The most frequent words, returned by GetStopWords
+    size_t stop_word_count = 10;
+    // Share of documents that repeat the words of an earlier one in another order
+    double duplicate_ratio = 0.01;
+    size_t min_query_length = 1;
+    size_t max_query_length = 4;
+    // Chance of each query to carry one minus word
+    double minus_word_ratio = 0.25;
+};
+
+struct GeneratedDocument {
+    int id;
+    std::string text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+// Synthetic documents and queries over a Zipf-distributed vocabulary. The
+// same options give the same corpus with any standard library, since the
+// generator and its distributions are its own rather than the
+// implementation-defined ones of <random>.
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(CorpusGeneratorOptions options = {});
+
+    // Documents with ids first_id, first_id + 1, ...; about 1 in 20 is not ACTUAL
+    std::vector<GeneratedDocument> GenerateDocuments(size_t count, int first_id = 0);
+    std::vector<std::string> GenerateQueries(size_t count);
+    std::vector<std::string> GetStopWords() const;
+
+    const CorpusGeneratorOptions& GetOptions() const {
+        return options_;
+    }
+
+private:
+    CorpusGeneratorOptions options_;
+    // SplitMix64
+    uint64_t state_;
+    std::vector<std::string> words_;
+    // cumulative_weights_[r] is the sum of the weights of ranks [0, r]
+    std::vector<double> cumulative_weights_;
+
+    uint64_t NextRandom();
+    // Uniform in [0, 1)
+    double NextDouble();
+    // Uniform in [min, max]
+    size_t NextInRange(size_t min, size_t max);
+    const std::string& NextWord();
+};
@@ -0,0 +1,187 @@
+#include "corpus_loader.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <execution>
+#include <numeric>
+#include <string_view>
+#include <thread>
+#include "snapshot.h"
+
+namespace {
+
+// Smallest slice of a window parsed by one thread
+const size_t MIN_CORPUS_SLICE_SIZE = 1 << 20;
+
+// Lines of one slice of a window
+struct ParsedSlice {
+    std::vector<DocumentToAdd> documents;
+    // Line of every document, counted from the start of the slice
+    std::vector<size_t> lines;
+    // index is the line counted from the start of the slice
+    std::vector<RejectedDocument> errors;
+    size_t line_count = 0;
+};
+
+// Position right after the first line break at or after `position`, or `end`
+const char* NextLineStart(const char* position, const char* end) {
+    const void* line_break = std::memchr(position, '\n', end - position);
+    return line_break == nullptr ? end : static_cast<const char*>(line_break) + 1;
+}
+
+// Splits off the text up to the next tab
+std::string_view TakeField(std::string_view& line) {
+    const size_t tab = line.find('\t');
+    const std::string_view field = line.substr(0, tab);
+    line.remove_prefix(tab == std::string_view::npos ? line.size() : tab + 1);
+    return field;
+}
+
+bool ParseInt(std::string_view text, int& value) {
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size();
+}
+
+bool ParseStatus(std::string_view text, DocumentStatus& status) {
+    static const std::pair<std::string_view, DocumentStatus> STATUSES[] = {
+        { "ACTUAL", DocumentStatus::ACTUAL },
+        { "IRRELEVANT", DocumentStatus::IRRELEVANT },
+        { "BANNED", DocumentStatus::BANNED },
+        { "REMOVED", DocumentStatus::REMOVED },
+    };
+    for (const auto& [name, value] : STATUSES) {
+        if (text == name) {
+            status = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseRatings(std::string_view text, std::vector<int>& ratings) {
+    while (!text.empty()) {
+        if (text.front() == ' ') {
+            text.remove_prefix(1);
+            continue;
+        }
+        int rating;
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), rating);
+        if (error != std::errc() || (end != text.data() + text.size() && *end != ' ')) {
+            return false;
+        }
+        ratings.push_back(rating);
+        text.remove_prefix(end - text.data());
+    }
+    return true;
+}
+
+// Returns an empty string on success, otherwise what is wrong with the line
+std::string ParseLine(std::string_view line, DocumentToAdd& document) {
+    document.id = -1;
+    if (!ParseInt(TakeField(line), document.id)) {
+        return "Invalid document_id";
+    }
+    if (!ParseStatus(TakeField(line), document.status)) {
+        return "Invalid status";
+    }
+    const size_t tab = line.find('\t');
+    if (tab == std::string_view::npos) {
+        return "Missing fields";
+    }
+    if (!ParseRatings(line.substr(0, tab), document.ratings)) {
+        return "Invalid ratings";
+    }
+    // The text is the rest of the line, tabs included
+    document.text = line.substr(tab + 1);
+    return {};
+}
+
+ParsedSlice ParseSlice(const char* begin, const char* end) {
+    ParsedSlice slice;
+    for (const char* line_begin = begin; line_begin != end; ++slice.line_count) {
+        const char* next_line = NextLineStart(line_begin, end);
+        std::string_view line(line_begin, next_line - line_begin);
+        line_begin = next_line;
+        if (!line.empty() && line.back() == '\n') {
+            line.remove_suffix(1);
+        }
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        DocumentToAdd document;
+        std::string error = ParseLine(line, document);
+        if (error.empty()) {
+            slice.documents.push_back(std::move(document));
+            slice.lines.push_back(slice.line_count);
+        } else {
+            slice.errors.push_back({ slice.line_count, document.id, std::move(error) });
+        }
+    }
+    return slice;
+}
+
+} // namespace
+
+CorpusLoadResult LoadCorpus(SearchServer& server, const std::string& path) {
+    const auto start_time = std::chrono::steady_clock::now();
+    const MappedFile file(path);
+    const char* const file_begin = reinterpret_cast<const char*>(file.data());
+    const char* const file_end = file_begin + file.size();
+
+    CorpusLoadResult result;
+    result.byte_count = file.size();
+    const size_t max_slice_count = std::max(1u, std::thread::hardware_concurrency()) * 4;
+    // Line numbers of the lines before the current window
+    size_t line_offset = 1;
+    for (const char* window_begin = file_begin; window_begin != file_end;) {
+        const char* window_end = file_end - window_begin <= static_cast<ptrdiff_t>(CORPUS_WINDOW_SIZE)
+            ? file_end : NextLineStart(window_begin + CORPUS_WINDOW_SIZE, file_end);
+
+        // Slice boundaries move forward to the next line start; a slice may end up empty
+        const size_t slice_count = std::clamp<size_t>((window_end - window_begin) / MIN_CORPUS_SLICE_SIZE, 1, max_slice_count);
+        std::vector<const char*> boundaries(slice_count + 1, window_end);
+        boundaries[0] = window_begin;
+        for (size_t slice = 1; slice < slice_count; ++slice) {
+            const char* position = window_begin + (window_end - window_begin) * slice / slice_count;
+            boundaries[slice] = std::max(boundaries[slice - 1], NextLineStart(position - 1, window_end));
+        }
+        std::vector<ParsedSlice> slices(slice_count);
+        std::vector<size_t> slice_indexes(slice_count);
+        std::iota(slice_indexes.begin(), slice_indexes.end(), 0);
+        std::for_each(std::execution::par, slice_indexes.begin(), slice_indexes.end(), [&](size_t slice) {
+            slices[slice] = ParseSlice(boundaries[slice], boundaries[slice + 1]);
+        });
+
+        std::vector<DocumentToAdd> documents;
+        std::vector<size_t> lines;
+        for (ParsedSlice& slice : slices) {
+            for (size_t i = 0; i < slice.documents.size(); ++i) {
+                documents.push_back(std::move(slice.documents[i]));
+                lines.push_back(line_offset + slice.lines[i]);
+            }
+            for (RejectedDocument& error : slice.errors) {
+                error.index += line_offset;
+                result.rejected.push_back(std::move(error));
+            }
+            line_offset += slice.line_count;
+        }
+
+        std::vector<RejectedDocument> rejected = server.AddDocuments(std::execution::par, documents);
+        result.document_count += documents.size() - rejected.size();
+        for (RejectedDocument& document : rejected) {
+            document.index = lines[document.index];
+            result.rejected.push_back(std::move(document));
+        }
+        window_begin = window_end;
+    }
+
+    std::sort(result.rejected.begin(), result.rejected.end(), [](const RejectedDocument& lhs, const RejectedDocument& rhs) {
+        return lhs.index < rhs.index;
+    });
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    return result;
+}
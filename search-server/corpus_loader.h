@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "search_server.h"
+
+// Bytes of a corpus file parsed and indexed in one step; bounds the memory
+// taken by parsed documents whatever the file size
+const size_t CORPUS_WINDOW_SIZE = 64 << 20;
+
+struct CorpusLoadResult {
+    size_t byte_count = 0;
+    // Documents added
+    size_t document_count = 0;
+    // index is the line number, counted from 1; lines without a readable id have document_id -1
+    std::vector<RejectedDocument> rejected;
+    double seconds = 0.0;
+
+    double GetMegabytesPerSecond() const {
+        return seconds > 0.0 ? byte_count / 1e6 / seconds : 0.0;
+    }
+};
+
+// Adds every document of a corpus file to the server. Each line is
+//
+//     id <TAB> status <TAB> ratings <TAB> text
+//
+// where status is ACTUAL, IRRELEVANT, BANNED or REMOVED and ratings are
+// integers separated by spaces, possibly none. Empty lines are skipped.
+//
+// The file is memory-mapped and split into slices at line boundaries that are
+// parsed on separate threads; AddDocuments then tokenizes them in parallel.
+// Document texts are read in place until the server stores them. Lines that
+// cannot be parsed or added are reported and skipped.
+CorpusLoadResult LoadCorpus(SearchServer& server, const std::string& path);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Counts that inverse document frequencies are computed from. A SearchServer
+// uses its own documents unless it is one part of a larger corpus, such as a
+// shard, whose relevance has to match that of the whole corpus.
+class CorpusStatistics {
+public:
+    virtual ~CorpusStatistics() = default;
+
+    virtual int GetDocumentCount() const = 0;
+    // Documents containing the word
+    virtual int GetDocumentFreq(std::string_view word) const = 0;
+    // Grows whenever the counts change
+    virtual uint64_t GetVersion() const = 0;
+};
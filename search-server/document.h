@@ -1,5 +1,9 @@
 #pragma once
 #include <iostream>
+
+// Relevances closer than this are considered equal
+const double EPSILON = 1e-6;
+
 struct Document {
     Document() = default;
 
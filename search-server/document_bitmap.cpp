@@ -0,0 +1,169 @@
+#include "document_bitmap.h"
+#include <algorithm>
+#include <iterator>
+
+void DocumentBitmap::Add(uint32_t value) {
+    const size_t key = value >> 16;
+    if (key >= containers_.size()) {
+        containers_.resize(key + 1);
+    }
+    containers_[key].Add(static_cast<uint16_t>(value));
+}
+
+void DocumentBitmap::Remove(uint32_t value) {
+    const size_t key = value >> 16;
+    if (key < containers_.size()) {
+        containers_[key].Remove(static_cast<uint16_t>(value));
+    }
+}
+
+void DocumentBitmap::AndNot(const DocumentBitmap& other) {
+    const size_t common = std::min(containers_.size(), other.containers_.size());
+    for (size_t key = 0; key < common; ++key) {
+        if (containers_[key].cardinality > 0 && other.containers_[key].cardinality > 0) {
+            containers_[key].AndNot(other.containers_[key]);
+        }
+    }
+}
+
+size_t DocumentBitmap::size() const {
+    size_t result = 0;
+    for (const Container& container : containers_) {
+        result += container.cardinality;
+    }
+    return result;
+}
+
+size_t DocumentBitmap::GetMemoryUsage() const {
+    size_t result = sizeof(*this) + containers_.capacity() * sizeof(Container);
+    for (const Container& container : containers_) {
+        result += container.array.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+    }
+    return result;
+}
+
+bool DocumentBitmap::ContainsAnyIn(uint32_t first, uint32_t last) const {
+    const size_t last_key = std::min<size_t>(last >> 16, containers_.size() - 1);
+    for (size_t key = first >> 16; key < containers_.size() && key <= last_key; ++key) {
+        const uint16_t low_first = key == (first >> 16) ? static_cast<uint16_t>(first) : 0;
+        const uint16_t low_last = key == (last >> 16) ? static_cast<uint16_t>(last) : UINT16_MAX;
+        if (containers_[key].ContainsAnyIn(low_first, low_last)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DocumentBitmap::Container::ContainsAnyIn(uint16_t first, uint16_t last) const {
+    if (cardinality == 0) {
+        return false;
+    }
+    if (!IsBitset()) {
+        const auto it = std::lower_bound(array.begin(), array.end(), first);
+        return it != array.end() && *it <= last;
+    }
+    for (size_t word = first / 64; word <= last / 64u; ++word) {
+        uint64_t bits_in_range = bits[word];
+        if (word == first / 64u) {
+            bits_in_range &= ~uint64_t{0} << (first % 64);
+        }
+        if (word == last / 64u) {
+            bits_in_range &= ~uint64_t{0} >> (63 - last % 64);
+        }
+        if (bits_in_range != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DocumentBitmap::Container::ContainsInArray(uint16_t low) const {
+    return std::binary_search(array.begin(), array.end(), low);
+}
+
+void DocumentBitmap::Container::Add(uint16_t low) {
+    if (IsBitset()) {
+        uint64_t& word = bits[low / 64];
+        const uint64_t mask = uint64_t{1} << (low % 64);
+        cardinality += (word & mask) == 0;
+        word |= mask;
+        return;
+    }
+    // Ordinals mostly arrive in increasing order
+    if (array.empty() || array.back() < low) {
+        array.push_back(low);
+    } else {
+        const auto it = std::lower_bound(array.begin(), array.end(), low);
+        if (*it == low) {
+            return;
+        }
+        array.insert(it, low);
+    }
+    ++cardinality;
+    if (cardinality > ARRAY_LIMIT) {
+        ToBitset();
+    }
+}
+
+void DocumentBitmap::Container::Remove(uint16_t low) {
+    if (IsBitset()) {
+        uint64_t& word = bits[low / 64];
+        const uint64_t mask = uint64_t{1} << (low % 64);
+        cardinality -= (word & mask) != 0;
+        word &= ~mask;
+        return;
+    }
+    const auto it = std::lower_bound(array.begin(), array.end(), low);
+    if (it != array.end() && *it == low) {
+        array.erase(it);
+        --cardinality;
+    }
+}
+
+void DocumentBitmap::Container::AndNot(const Container& other) {
+    if (IsBitset() && other.IsBitset()) {
+        cardinality = 0;
+        for (size_t i = 0; i < BITSET_WORDS; ++i) {
+            bits[i] &= ~other.bits[i];
+            cardinality += __builtin_popcountll(bits[i]);
+        }
+    } else if (IsBitset()) {
+        for (const uint16_t low : other.array) {
+            Remove(low);
+        }
+    } else if (other.IsBitset()) {
+        array.erase(std::remove_if(array.begin(), array.end(), [&other](uint16_t low) {
+            return other.Contains(low);
+        }), array.end());
+        cardinality = static_cast<uint32_t>(array.size());
+    } else {
+        std::vector<uint16_t> difference;
+        difference.reserve(array.size());
+        std::set_difference(array.begin(), array.end(), other.array.begin(), other.array.end(),
+                            std::back_inserter(difference));
+        array = std::move(difference);
+        cardinality = static_cast<uint32_t>(array.size());
+    }
+    if (IsBitset() && cardinality <= ARRAY_LIMIT) {
+        ToArray();
+    }
+}
+
+void DocumentBitmap::Container::ToBitset() {
+    bits.assign(BITSET_WORDS, 0);
+    for (const uint16_t low : array) {
+        bits[low / 64] |= uint64_t{1} << (low % 64);
+    }
+    array = {};
+}
+
+void DocumentBitmap::Container::ToArray() {
+    array.clear();
+    array.reserve(cardinality);
+    for (size_t i = 0; i < BITSET_WORDS; ++i) {
+        for (uint64_t word = bits[i]; word != 0; word &= word - 1) {
+            array.push_back(static_cast<uint16_t>(i * 64 + __builtin_ctzll(word)));
+        }
+    }
+    bits = {};
+}
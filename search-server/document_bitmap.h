@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compressed set of document ordinals in the spirit of Roaring bitmaps. Values
+// are split by their high 16 bits into containers; a container holds a sorted
+// array of low halves while it is small and switches to a 65536-bit bitset
+// once the array would take more memory than the bitset.
+class DocumentBitmap {
+public:
+    void Add(uint32_t value);
+    void Remove(uint32_t value);
+
+    bool Contains(uint32_t value) const {
+        const size_t key = value >> 16;
+        return key < containers_.size() && containers_[key].Contains(static_cast<uint16_t>(value));
+    }
+
+    // True if any value of [first, last] is in the set
+    bool ContainsAnyIn(uint32_t first, uint32_t last) const;
+
+    // Removes every value that is also in `other`, a bitset word at a time where possible
+    void AndNot(const DocumentBitmap& other);
+
+    size_t size() const;
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    size_t GetMemoryUsage() const;
+
+private:
+    // Largest array container; 4096 uint16_t take as much memory as the bitset
+    static constexpr size_t ARRAY_LIMIT = 4096;
+    static constexpr size_t BITSET_WORDS = 65536 / 64;
+
+    struct Container {
+        std::vector<uint16_t> array;
+        std::vector<uint64_t> bits;
+        uint32_t cardinality = 0;
+
+        bool IsBitset() const {
+            return !bits.empty();
+        }
+
+        bool Contains(uint16_t low) const {
+            if (IsBitset()) {
+                return (bits[low / 64] >> (low % 64)) & 1;
+            }
+            return ContainsInArray(low);
+        }
+
+        bool ContainsInArray(uint16_t low) const;
+        bool ContainsAnyIn(uint16_t first, uint16_t last) const;
+        void Add(uint16_t low);
+        void Remove(uint16_t low);
+        void AndNot(const Container& other);
+        void ToBitset();
+        void ToArray();
+    };
+
+    // Indexed by the high 16 bits; ordinals are dense, so few containers stay empty
+    std::vector<Container> containers_;
+};
@@ -0,0 +1,159 @@
+#include "durable_search_server.h"
+#include <stdexcept>
+#include <sys/stat.h>
+
+void DurableSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    uint64_t first_sequence;
+    {
+        std::lock_guard guard(write_mutex_);
+        // A rejected document throws before anything is logged
+        CheckNewDocument(document_id, document);
+        first_sequence = appended_sequence_;
+        appended_sequence_ = log_.AppendAddDocument(document_id, document, status, ratings);
+        AddPendingChange(document_id, true, appended_sequence_);
+    }
+    CommitAndApply(first_sequence, first_sequence + 1, { document_id }, [&] {
+        server_.AddDocument(document_id, document, status, ratings);
+    });
+}
+
+std::vector<RejectedDocument> DurableSearchServer::AddDocuments(const std::vector<DocumentToAdd>& documents) {
+    std::vector<RejectedDocument> rejected;
+    std::vector<DocumentToAdd> accepted;
+    std::vector<int> accepted_ids;
+    uint64_t first_sequence;
+    {
+        std::lock_guard guard(write_mutex_);
+        first_sequence = appended_sequence_;
+        for (size_t i = 0; i < documents.size(); ++i) {
+            const DocumentToAdd& document = documents[i];
+            try {
+                CheckNewDocument(document.id, document.text);
+            } catch (const std::invalid_argument& e) {
+                rejected.push_back({ i, document.id, e.what() });
+                continue;
+            }
+            appended_sequence_ = log_.AppendAddDocument(document.id, document.text, document.status, document.ratings);
+            AddPendingChange(document.id, true, appended_sequence_);
+            accepted.push_back(document);
+            accepted_ids.push_back(document.id);
+        }
+    }
+    if (!accepted.empty()) {
+        CommitAndApply(first_sequence, first_sequence + accepted.size(), accepted_ids, [&] {
+            server_.AddDocuments(std::execution::par, accepted);
+        });
+    }
+    return rejected;
+}
+
+void DurableSearchServer::RemoveDocument(int document_id) {
+    uint64_t first_sequence;
+    {
+        std::lock_guard guard(write_mutex_);
+        if (!WillExist(document_id)) {
+            return;
+        }
+        first_sequence = appended_sequence_;
+        appended_sequence_ = log_.AppendRemoveDocument(document_id);
+        AddPendingChange(document_id, false, appended_sequence_);
+    }
+    CommitAndApply(first_sequence, first_sequence + 1, { document_id }, [&] {
+        server_.RemoveDocument(document_id);
+    });
+}
+
+void DurableSearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    std::vector<int> removed_ids;
+    uint64_t first_sequence;
+    {
+        std::lock_guard guard(write_mutex_);
+        first_sequence = appended_sequence_;
+        for (const int document_id : document_ids) {
+            // Also skips an id listed twice
+            if (WillExist(document_id)) {
+                appended_sequence_ = log_.AppendRemoveDocument(document_id);
+                AddPendingChange(document_id, false, appended_sequence_);
+                removed_ids.push_back(document_id);
+            }
+        }
+    }
+    if (!removed_ids.empty()) {
+        CommitAndApply(first_sequence, first_sequence + removed_ids.size(), removed_ids, [&] {
+            server_.RemoveDocuments(removed_ids);
+        });
+    }
+}
+
+void DurableSearchServer::Checkpoint() {
+    std::unique_lock lock(write_mutex_);
+    // Logged changes the index does not hold yet would be lost with the log
+    change_applied_.wait(lock, [this] {
+        return applied_sequence_ == appended_sequence_;
+    });
+    // SaveSnapshot returns once the rename of the new snapshot is durable. It
+    // must be: if the log were cut first, a power loss could bring back the
+    // old snapshot with an empty log and lose every change since it.
+    server_.SaveSnapshot(snapshot_path_);
+    // If this is cut short the next start replays records the snapshot already
+    // holds. That is harmless: the last record for an id decides whether the
+    // document exists, and re-adding a document that exists is rejected.
+    log_.Truncate();
+}
+
+void DurableSearchServer::Sync() {
+    log_.Sync();
+}
+
+int DurableSearchServer::GetDocumentCount() const {
+    return server_.GetDocumentCount();
+}
+
+const SearchServer& DurableSearchServer::GetServer() const {
+    return server_;
+}
+
+size_t DurableSearchServer::GetReplayedRecordCount() const {
+    return replayed_record_count_;
+}
+
+bool DurableSearchServer::FileExists(const std::string& path) {
+    struct stat status;
+    return stat(path.c_str(), &status) == 0;
+}
+
+void DurableSearchServer::ApplyLogRecords(const std::vector<LogRecord>& records) {
+    // Runs of additions go through the bulk path; the snapshot may already
+    // hold some of them, and those are rejected as duplicates
+    std::vector<DocumentToAdd> documents;
+    for (const LogRecord& record : records) {
+        if (record.type == LogRecord::Type::ADD_DOCUMENT) {
+            documents.push_back({ record.document_id, record.text, record.status, record.ratings });
+            continue;
+        }
+        if (!documents.empty()) {
+            server_.AddDocuments(std::execution::par, documents);
+            documents.clear();
+        }
+        server_.RemoveDocument(record.document_id);
+    }
+    if (!documents.empty()) {
+        server_.AddDocuments(std::execution::par, documents);
+    }
+}
+
+bool DurableSearchServer::WillExist(int document_id) const {
+    const auto it = pending_changes_.find(document_id);
+    return it != pending_changes_.end() ? it->second.exists : server_.HasDocument(document_id);
+}
+
+void DurableSearchServer::CheckNewDocument(int document_id, std::string_view document) const {
+    if (document_id < 0 || WillExist(document_id)) {
+        throw std::invalid_argument("Invalid document_id");
+    }
+    SearchServer::CheckDocumentText(document);
+}
+
+void DurableSearchServer::AddPendingChange(int document_id, bool exists, uint64_t sequence) {
+    pending_changes_[document_id] = { exists, sequence };
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+// SearchServer whose changes survive a restart. It starts from the last
+// snapshot, if there is one, and replays the write-ahead log on top of it.
+// Every later change is checked, logged and committed before it is applied,
+// so the index never holds a change the log could lose. Checkpoint saves a
+// new snapshot and empties the log.
+//
+// Changes may come from several threads; their log writes are grouped, and
+// they are applied in log order. Queries follow the rules of SearchServer and
+// must not overlap changes.
+class DurableSearchServer {
+public:
+    // stop_words are used only while there is no snapshot yet
+    template <typename StopWords>
+    DurableSearchServer(const StopWords& stop_words, const std::string& snapshot_path, const std::string& log_path,
+                        WriteAheadLogOptions options = {});
+
+    // A change becomes visible to queries once it is durable. If the log cannot
+    // be written the call throws std::runtime_error and the index is unchanged.
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    std::vector<RejectedDocument> AddDocuments(const std::vector<DocumentToAdd>& documents);
+    // Unknown ids are skipped and not logged
+    void RemoveDocument(int document_id);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    // Saves a snapshot of the whole index, then empties the log
+    void Checkpoint();
+    // Syncs logged changes that WriteAheadLogOptions let wait
+    void Sync();
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args&&... args) const;
+
+    template <typename... Args>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(Args&&... args) const;
+
+    int GetDocumentCount() const;
+
+    const SearchServer& GetServer() const;
+
+    // Log records applied on startup
+    size_t GetReplayedRecordCount() const;
+
+private:
+    std::string snapshot_path_;
+    SearchServer server_;
+    WriteAheadLog log_;
+    // Orders checks and log appends, and guards server_ while changes are applied
+    std::mutex write_mutex_;
+    std::condition_variable change_applied_;
+    // Sequence number of the last log record appended, and of the last one
+    // applied to server_ (or dropped because its commit failed)
+    uint64_t appended_sequence_ = 0;
+    uint64_t applied_sequence_ = 0;
+    // Whether each document with a logged but not yet applied change will
+    // exist, and the sequence number of its last such change
+    struct PendingChange {
+        bool exists;
+        uint64_t sequence;
+    };
+    std::unordered_map<int, PendingChange> pending_changes_;
+    size_t replayed_record_count_ = 0;
+
+    template <typename StopWords>
+    static SearchServer LoadOrCreate(const StopWords& stop_words, const std::string& snapshot_path);
+    static bool FileExists(const std::string& path);
+
+    void ApplyLogRecords(const std::vector<LogRecord>& records);
+
+    // Whether the document will exist once the logged changes are applied
+    bool WillExist(int document_id) const;
+    // Throws what SearchServer::AddDocument would throw after the logged changes
+    void CheckNewDocument(int document_id, std::string_view document) const;
+    void AddPendingChange(int document_id, bool exists, uint64_t sequence);
+    // Commits records (first_sequence, last_sequence], then calls apply() in log
+    // order; the documents' pending changes are dropped either way
+    template <typename Apply>
+    void CommitAndApply(uint64_t first_sequence, uint64_t last_sequence,
+                        const std::vector<int>& document_ids, Apply apply);
+};
+
+template <typename StopWords>
+DurableSearchServer::DurableSearchServer(const StopWords& stop_words, const std::string& snapshot_path,
+                                         const std::string& log_path, WriteAheadLogOptions options)
+    : snapshot_path_(snapshot_path)
+    , server_(LoadOrCreate(stop_words, snapshot_path))
+    , log_(log_path, options)
+{
+    replayed_record_count_ = log_.Replay([this](const std::vector<LogRecord>& records) {
+        ApplyLogRecords(records);
+    });
+}
+
+template <typename... Args>
+std::vector<Document> DurableSearchServer::FindTopDocuments(Args&&... args) const {
+    return server_.FindTopDocuments(std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+std::tuple<std::vector<std::string_view>, DocumentStatus> DurableSearchServer::MatchDocument(Args&&... args) const {
+    return server_.MatchDocument(std::forward<Args>(args)...);
+}
+
+template <typename Apply>
+void DurableSearchServer::CommitAndApply(uint64_t first_sequence, uint64_t last_sequence,
+                                         const std::vector<int>& document_ids, Apply apply) {
+    std::exception_ptr error;
+    try {
+        // Other threads' changes can join this commit while it waits
+        log_.Commit(last_sequence);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    std::unique_lock lock(write_mutex_);
+    change_applied_.wait(lock, [this, first_sequence] {
+        return applied_sequence_ == first_sequence;
+    });
+    // A failed write fails every later commit too, so no later change is
+    // applied on top of a lost one
+    if (!error) {
+        try {
+            apply();
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    applied_sequence_ = last_sequence;
+    for (const int document_id : document_ids) {
+        const auto it = pending_changes_.find(document_id);
+        if (it != pending_changes_.end() && it->second.sequence <= last_sequence) {
+            pending_changes_.erase(it);
+        }
+    }
+    change_applied_.notify_all();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+template <typename StopWords>
+SearchServer DurableSearchServer::LoadOrCreate(const StopWords& stop_words, const std::string& snapshot_path) {
+    if (FileExists(snapshot_path)) {
+        return SearchServer::LoadSnapshot(snapshot_path);
+    }
+    return SearchServer(stop_words);
+}
@@ -0,0 +1,64 @@
+#include "forward_index.h"
+#include <algorithm>
+
+void ForwardIndex::Add(const std::vector<TermFrequency>& terms) {
+    pool_.insert(pool_.end(), terms.begin(), terms.end());
+    offsets_.push_back(pool_.size());
+}
+
+const TermFrequency* ForwardIndex::Find(uint32_t ordinal, uint32_t term_id) const {
+    const Range terms = Get(ordinal);
+    const TermFrequency* it = std::lower_bound(terms.begin(), terms.end(), term_id,
+        [](const TermFrequency& entry, uint32_t id) {
+            return entry.term_id < id;
+        });
+    return it != terms.end() && it->term_id == term_id ? it : nullptr;
+}
+
+void ForwardIndex::Purge(const DocumentBitmap& removed) {
+    std::vector<TermFrequency> pool;
+    std::vector<size_t> offsets = {0};
+    offsets.reserve(size() + 1);
+    for (uint32_t ordinal = 0; ordinal < size(); ++ordinal) {
+        if (!removed.Contains(ordinal)) {
+            const Range terms = Get(ordinal);
+            pool.insert(pool.end(), terms.begin(), terms.end());
+        }
+        offsets.push_back(pool.size());
+    }
+    pool_ = std::move(pool);
+    offsets_ = std::move(offsets);
+    mapped_pool_ = nullptr;
+    mapped_offsets_ = nullptr;
+    mapped_count_ = 0;
+}
+
+void ForwardIndex::Save(SnapshotWriter& writer) const {
+    std::vector<uint64_t> offsets;
+    offsets.reserve(size() + 1);
+    const uint64_t mapped_size = mapped_count_ > 0 ? mapped_offsets_[mapped_count_] : 0;
+    offsets.assign(mapped_offsets_, mapped_offsets_ + mapped_count_);
+    for (const size_t offset : offsets_) {
+        offsets.push_back(mapped_size + offset);
+    }
+    writer.WriteArray(offsets.data(), offsets.size());
+
+    writer.Write(static_cast<uint64_t>(offsets.back()));
+    writer.WriteRaw(mapped_pool_, mapped_size * sizeof(TermFrequency));
+    writer.WriteRaw(pool_.data(), pool_.size() * sizeof(TermFrequency));
+    writer.Align();
+}
+
+ForwardIndex ForwardIndex::Load(SnapshotReader& reader) {
+    const auto offsets = reader.ReadArray<uint64_t>();
+    const auto pool = reader.ReadArray<TermFrequency>();
+    if (offsets.size() == 0 || offsets.size() - 1 > UINT32_MAX || offsets.begin()[0] != 0
+        || !std::is_sorted(offsets.begin(), offsets.end()) || offsets.begin()[offsets.size() - 1] != pool.size()) {
+        SnapshotReader::ThrowCorrupt();
+    }
+    ForwardIndex forward_index;
+    forward_index.mapped_pool_ = pool.begin();
+    forward_index.mapped_offsets_ = offsets.begin();
+    forward_index.mapped_count_ = static_cast<uint32_t>(offsets.size() - 1);
+    return forward_index;
+}
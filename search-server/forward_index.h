@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "paginator.h"
+#include "document_bitmap.h"
+#include "snapshot.h"
+
+struct TermFrequency {
+    uint32_t term_id;
+    double term_freq;
+};
+
+// Terms of every document, indexed by internal document ordinal. Each
+// document's (term id, frequency) pairs are sorted by term id and all of them
+// share one contiguous pool.
+class ForwardIndex {
+public:
+    using Range = IteratorRange<const TermFrequency*>;
+
+    // Appends the next ordinal's terms; they must be sorted by term id
+    void Add(const std::vector<TermFrequency>& terms);
+
+    Range Get(uint32_t ordinal) const {
+        if (ordinal < mapped_count_) {
+            return Range(mapped_pool_ + mapped_offsets_[ordinal], mapped_pool_ + mapped_offsets_[ordinal + 1]);
+        }
+        const TermFrequency* base = pool_.data();
+        ordinal -= mapped_count_;
+        return Range(base + offsets_[ordinal], base + offsets_[ordinal + 1]);
+    }
+
+    // Number of ordinals added so far
+    size_t size() const {
+        return mapped_count_ + offsets_.size() - 1;
+    }
+
+    // Returns nullptr if the document does not contain the term
+    const TermFrequency* Find(uint32_t ordinal, uint32_t term_id) const;
+
+    // Rebuilds the pool without the terms of `removed` documents, whose ranges
+    // become empty. Documents read from a snapshot are copied into memory.
+    void Purge(const DocumentBitmap& removed);
+
+    void Save(SnapshotWriter& writer) const;
+    // Documents of the snapshot stay in its mapping; later ones are added in memory
+    static ForwardIndex Load(SnapshotReader& reader);
+
+    size_t GetMemoryUsage() const {
+        return pool_.capacity() * sizeof(TermFrequency) + offsets_.capacity() * sizeof(size_t);
+    }
+
+private:
+    // Ordinals [0, mapped_count_) come from a snapshot
+    const TermFrequency* mapped_pool_ = nullptr;
+    const uint64_t* mapped_offsets_ = nullptr;
+    uint32_t mapped_count_ = 0;
+    std::vector<TermFrequency> pool_;
+    // Ordinal mapped_count_ + i owns pool_[offsets_[i], offsets_[i + 1])
+    std::vector<size_t> offsets_ = {0};
+};
@@ -0,0 +1,254 @@
+#include "index_segment.h"
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+IndexSegment::IndexSegment(uint32_t first_ordinal)
+    : first_ordinal_(first_ordinal)
+    , end_ordinal_(first_ordinal)
+{
+}
+
+void IndexSegment::Add(TermId term_id, uint32_t ordinal, uint32_t count, double term_freq) {
+    open_postings_[term_id].Add(ordinal, count, term_freq);
+    end_ordinal_ = std::max(end_ordinal_, ordinal + 1);
+}
+
+void IndexSegment::Extend(uint32_t end_ordinal) {
+    end_ordinal_ = std::max(end_ordinal_, end_ordinal);
+}
+
+void IndexSegment::Purge(TermId term_id, const DocumentBitmap& removed) {
+    const auto it = open_postings_.find(term_id);
+    if (it != open_postings_.end()) {
+        it->second.Purge(removed);
+    }
+}
+
+struct IndexSegment::SealedStorage {
+    std::vector<TermId> term_ids;
+    std::vector<SealedPostings> postings;
+    std::vector<PostingList::Block> blocks;
+    std::vector<uint8_t> data;
+    std::vector<uint32_t> tail_ordinals;
+    std::vector<uint32_t> tail_counts;
+
+    // Room for term_count lists whose arrays add up to those of `totals`
+    void Reserve(size_t term_count, const PostingList::View& totals) {
+        term_ids.reserve(term_count);
+        postings.reserve(term_count);
+        blocks.reserve(totals.block_count);
+        data.reserve(totals.data_size);
+        tail_ordinals.reserve(totals.tail_size);
+        tail_counts.reserve(totals.tail_size);
+    }
+
+    void Add(TermId term_id, const PostingList::View& view) {
+        term_ids.push_back(term_id);
+        postings.push_back({ blocks.size(), data.size(), view.data_size, tail_ordinals.size(), view.size,
+                             static_cast<uint32_t>(view.block_count), static_cast<uint32_t>(view.tail_size), view.max_term_freq });
+        blocks.insert(blocks.end(), view.blocks, view.blocks + view.block_count);
+        data.insert(data.end(), view.data, view.data + view.data_size);
+        tail_ordinals.insert(tail_ordinals.end(), view.tail_ordinals, view.tail_ordinals + view.tail_size);
+        tail_counts.insert(tail_counts.end(), view.tail_counts, view.tail_counts + view.tail_size);
+    }
+
+    void ShrinkToFit() {
+        term_ids.shrink_to_fit();
+        postings.shrink_to_fit();
+        blocks.shrink_to_fit();
+        data.shrink_to_fit();
+        tail_ordinals.shrink_to_fit();
+        tail_counts.shrink_to_fit();
+    }
+};
+
+void IndexSegment::Seal() {
+    if (sealed_) {
+        return;
+    }
+    SetStorage(BuildSealedStorage());
+    open_postings_ = {};
+    sealed_ = true;
+}
+
+void IndexSegment::Reopen() {
+    if (!sealed_) {
+        return;
+    }
+    const DocumentBitmap none;
+    for (size_t i = 0; i < term_count_; ++i) {
+        open_postings_[term_ids_[i]].Append(GetPostings(i), none);
+    }
+    storage_.reset();
+    term_ids_ = nullptr;
+    postings_ = nullptr;
+    blocks_ = nullptr;
+    data_ = nullptr;
+    tail_ordinals_ = nullptr;
+    tail_counts_ = nullptr;
+    term_count_ = block_count_ = data_size_ = tail_size_ = 0;
+    sealed_ = false;
+}
+
+std::shared_ptr<IndexSegment::SealedStorage> IndexSegment::BuildSealedStorage() const {
+    std::vector<TermId> term_ids;
+    term_ids.reserve(open_postings_.size());
+    PostingList::View totals;
+    for (const auto& [term_id, postings] : open_postings_) {
+        // Lists emptied by Purge are dropped
+        if (!postings.empty()) {
+            const PostingList::View view = postings.GetView();
+            term_ids.push_back(term_id);
+            totals.block_count += view.block_count;
+            totals.data_size += view.data_size;
+            totals.tail_size += view.tail_size;
+        }
+    }
+    std::sort(term_ids.begin(), term_ids.end());
+
+    auto storage = std::make_shared<SealedStorage>();
+    storage->Reserve(term_ids.size(), totals);
+    for (const TermId term_id : term_ids) {
+        storage->Add(term_id, open_postings_.at(term_id).GetView());
+    }
+    return storage;
+}
+
+void IndexSegment::SetStorage(std::shared_ptr<const SealedStorage> storage) {
+    term_ids_ = storage->term_ids.data();
+    postings_ = storage->postings.data();
+    term_count_ = storage->term_ids.size();
+    blocks_ = storage->blocks.data();
+    block_count_ = storage->blocks.size();
+    data_ = storage->data.data();
+    data_size_ = storage->data.size();
+    tail_ordinals_ = storage->tail_ordinals.data();
+    tail_counts_ = storage->tail_counts.data();
+    tail_size_ = storage->tail_ordinals.size();
+    storage_ = std::move(storage);
+}
+
+PostingList::View IndexSegment::Find(TermId term_id) const {
+    if (!sealed_) {
+        const auto it = open_postings_.find(term_id);
+        return it == open_postings_.end() ? PostingList::View() : it->second.GetView();
+    }
+    const TermId* it = std::lower_bound(term_ids_, term_ids_ + term_count_, term_id);
+    if (it == term_ids_ + term_count_ || *it != term_id) {
+        return PostingList::View();
+    }
+    return GetPostings(it - term_ids_);
+}
+
+PostingList::View IndexSegment::GetPostings(size_t index) const {
+    const SealedPostings& postings = postings_[index];
+    return { blocks_ + postings.first_block, postings.block_count, data_ + postings.data_offset, postings.data_size,
+             tail_ordinals_ + postings.first_tail, tail_counts_ + postings.first_tail, postings.tail_size,
+             postings.size, postings.max_term_freq };
+}
+
+size_t IndexSegment::GetMemoryUsage() const {
+    size_t bytes = term_count_ * (sizeof(TermId) + sizeof(SealedPostings)) + block_count_ * sizeof(PostingList::Block)
+        + data_size_ + tail_size_ * 2 * sizeof(uint32_t);
+    for (const auto& [term_id, postings] : open_postings_) {
+        bytes += sizeof(TermId) + postings.GetMemoryUsage();
+    }
+    return bytes;
+}
+
+IndexSegment IndexSegment::Merge(const std::vector<const IndexSegment*>& segments, const DocumentBitmap& removed) {
+    IndexSegment merged(segments.front()->first_ordinal_);
+    merged.end_ordinal_ = segments.back()->end_ordinal_;
+    merged.sealed_ = true;
+
+    std::vector<TermId> term_ids;
+    PostingList::View totals;
+    for (const IndexSegment* segment : segments) {
+        term_ids.insert(term_ids.end(), segment->term_ids_, segment->term_ids_ + segment->term_count_);
+        totals.block_count += segment->block_count_;
+        totals.data_size += segment->data_size_;
+        totals.tail_size += segment->tail_size_;
+    }
+    std::sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+
+    auto storage = std::make_shared<SealedStorage>();
+    // Merged lists are never larger than their sources together
+    storage->Reserve(term_ids.size(), totals);
+    // Position of the next term to look at in every source segment
+    std::vector<size_t> positions(segments.size());
+    for (const TermId term_id : term_ids) {
+        PostingList postings;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            const IndexSegment& segment = *segments[i];
+            if (positions[i] < segment.term_count_ && segment.term_ids_[positions[i]] == term_id) {
+                postings.Append(segment.GetPostings(positions[i]), removed);
+                ++positions[i];
+            }
+        }
+        if (!postings.empty()) {
+            storage->Add(term_id, postings.GetView());
+        }
+    }
+    storage->ShrinkToFit();
+    merged.SetStorage(std::move(storage));
+    return merged;
+}
+
+void IndexSegment::Save(SnapshotWriter& writer) const {
+    // An open segment is written through a temporary sealed copy
+    std::optional<IndexSegment> sealed_copy;
+    const IndexSegment* segment = this;
+    if (!sealed_) {
+        sealed_copy.emplace(first_ordinal_);
+        sealed_copy->end_ordinal_ = end_ordinal_;
+        sealed_copy->sealed_ = true;
+        sealed_copy->SetStorage(BuildSealedStorage());
+        segment = &*sealed_copy;
+    }
+    writer.Write(segment->first_ordinal_);
+    writer.Write(segment->end_ordinal_);
+    writer.WriteArray(segment->term_ids_, segment->term_count_);
+    writer.WriteArray(segment->postings_, segment->term_count_);
+    writer.WriteArray(segment->blocks_, segment->block_count_);
+    writer.WriteArray(segment->data_, segment->data_size_);
+    writer.WriteArray(segment->tail_ordinals_, segment->tail_size_);
+    writer.WriteArray(segment->tail_counts_, segment->tail_size_);
+}
+
+IndexSegment IndexSegment::Load(SnapshotReader& reader) {
+    IndexSegment segment(reader.Read<uint32_t>());
+    segment.end_ordinal_ = reader.Read<uint32_t>();
+    segment.sealed_ = true;
+    const auto term_ids = reader.ReadArray<TermId>();
+    const auto postings = reader.ReadArray<SealedPostings>();
+    const auto blocks = reader.ReadArray<PostingList::Block>();
+    const auto data = reader.ReadArray<uint8_t>();
+    const auto tail_ordinals = reader.ReadArray<uint32_t>();
+    const auto tail_counts = reader.ReadArray<uint32_t>();
+    if (segment.end_ordinal_ < segment.first_ordinal_ || postings.size() != term_ids.size()
+        || tail_counts.size() != tail_ordinals.size()) {
+        SnapshotReader::ThrowCorrupt();
+    }
+    // Only the layout is checked here; the checksum covers the encoded postings
+    for (const SealedPostings& entry : postings) {
+        if (entry.first_block + entry.block_count > blocks.size() || entry.data_offset + entry.data_size > data.size()
+            || entry.first_tail + entry.tail_size > tail_ordinals.size() || entry.tail_size > PostingList::BLOCK_SIZE) {
+            SnapshotReader::ThrowCorrupt();
+        }
+    }
+
+    segment.storage_ = reader.GetFile();
+    segment.term_ids_ = term_ids.begin();
+    segment.postings_ = postings.begin();
+    segment.term_count_ = term_ids.size();
+    segment.blocks_ = blocks.begin();
+    segment.block_count_ = blocks.size();
+    segment.data_ = data.begin();
+    segment.data_size_ = data.size();
+    segment.tail_ordinals_ = tail_ordinals.begin();
+    segment.tail_counts_ = tail_counts.begin();
+    segment.tail_size_ = tail_ordinals.size();
+    return segment;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "document_bitmap.h"
+#include "posting_list.h"
+#include "snapshot.h"
+#include "term_dictionary.h"
+
+// Postings of the documents in one contiguous range of ordinals.
+//
+// A segment starts open: documents are appended to it and its posting lists
+// live in a hash map. Seal turns it into an immutable, read-optimized layout:
+// the compressed blocks of all posting lists in a few flat arrays, ordered by
+// term id, which a snapshot stores and maps back as they are. Segments follow
+// each other in ordinal order, so merging them is plain concatenation.
+class IndexSegment {
+public:
+    using TermId = TermDictionary::TermId;
+
+    explicit IndexSegment(uint32_t first_ordinal);
+
+    // Open segments only; ordinals of a term must keep growing
+    void Add(TermId term_id, uint32_t ordinal, uint32_t count, double term_freq);
+    // Makes the segment cover ordinals up to end_ordinal even if they have no postings
+    void Extend(uint32_t end_ordinal);
+    // Open segments only; drops the term's postings of `removed` documents.
+    // Purging different terms from several threads at once is safe.
+    void Purge(TermId term_id, const DocumentBitmap& removed);
+
+    void Seal();
+    // Turns a sealed segment back into an open one holding copies of its postings
+    void Reopen();
+
+    bool IsSealed() const {
+        return sealed_;
+    }
+
+    // Empty if no document of the segment contains the term; valid until the segment changes
+    PostingList::View Find(TermId term_id) const;
+
+    // Covered ordinals are [GetFirstOrdinal(), GetEndOrdinal())
+    uint32_t GetFirstOrdinal() const {
+        return first_ordinal_;
+    }
+
+    uint32_t GetEndOrdinal() const {
+        return end_ordinal_;
+    }
+
+    uint32_t GetOrdinalCount() const {
+        return end_ordinal_ - first_ordinal_;
+    }
+
+    // Includes sealed arrays that live in a snapshot mapping
+    size_t GetMemoryUsage() const;
+
+    // One sealed segment covering adjacent sealed segments, without the
+    // postings of `removed` documents
+    static IndexSegment Merge(const std::vector<const IndexSegment*>& segments, const DocumentBitmap& removed);
+
+    // Open segments are saved in the sealed layout too
+    void Save(SnapshotWriter& writer) const;
+    // A sealed segment whose arrays point into the reader's mapping
+    static IndexSegment Load(SnapshotReader& reader);
+
+private:
+    // Where one term's postings are in the flat arrays of a sealed segment
+    struct SealedPostings {
+        uint64_t first_block;
+        uint64_t data_offset;
+        uint64_t data_size;
+        uint64_t first_tail;
+        uint64_t size;
+        uint32_t block_count;
+        uint32_t tail_size;
+        double max_term_freq;
+    };
+
+    // Sealed arrays owned by the segment rather than by a snapshot
+    struct SealedStorage;
+
+    uint32_t first_ordinal_;
+    uint32_t end_ordinal_;
+    bool sealed_ = false;
+    // While open
+    std::unordered_map<TermId, PostingList> open_postings_;
+    // Once sealed. term_ids_ is sorted and parallel to postings_; the arrays
+    // belong to storage_, either a SealedStorage or a MappedFile.
+    std::shared_ptr<const void> storage_;
+    const TermId* term_ids_ = nullptr;
+    const SealedPostings* postings_ = nullptr;
+    size_t term_count_ = 0;
+    const PostingList::Block* blocks_ = nullptr;
+    size_t block_count_ = 0;
+    const uint8_t* data_ = nullptr;
+    size_t data_size_ = 0;
+    const uint32_t* tail_ordinals_ = nullptr;
+    const uint32_t* tail_counts_ = nullptr;
+    size_t tail_size_ = 0;
+
+    PostingList::View GetPostings(size_t index) const;
+    // Open postings in the sealed layout, without emptied lists
+    std::shared_ptr<SealedStorage> BuildSealedStorage() const;
+    void SetStorage(std::shared_ptr<const SealedStorage> storage);
+};
@@ -0,0 +1,47 @@
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+
+size_t LatencyHistogram::GetBucket(std::chrono::nanoseconds latency) {
+    const uint64_t value = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+    if (value < (uint64_t{1} << LATENCY_SUB_BUCKET_BITS)) {
+        return value;
+    }
+    const int exponent = 63 - __builtin_clzll(value);
+    if (exponent >= LATENCY_MAX_EXPONENT) {
+        return LATENCY_BUCKET_COUNT - 1;
+    }
+    const int shift = exponent - LATENCY_SUB_BUCKET_BITS;
+    // The top bit is implied by the group, the next LATENCY_SUB_BUCKET_BITS pick the bucket
+    const size_t sub_bucket = (value >> shift) - (uint64_t{1} << LATENCY_SUB_BUCKET_BITS);
+    return ((static_cast<size_t>(shift) + 1) << LATENCY_SUB_BUCKET_BITS) + sub_bucket;
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetBucketLimit(size_t bucket) {
+    const size_t group = bucket >> LATENCY_SUB_BUCKET_BITS;
+    const uint64_t sub_bucket = bucket & ((size_t{1} << LATENCY_SUB_BUCKET_BITS) - 1);
+    if (group == 0) {
+        return std::chrono::nanoseconds(sub_bucket);
+    }
+    const uint64_t first = ((uint64_t{1} << LATENCY_SUB_BUCKET_BITS) + sub_bucket) << (group - 1);
+    return std::chrono::nanoseconds(first + (uint64_t{1} << (group - 1)) - 1);
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetPercentile(double fraction) const {
+    if (count_ == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    const uint64_t rank = std::clamp<uint64_t>(static_cast<uint64_t>(std::ceil(fraction * count_)), 1, count_);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+        seen += counts_[bucket];
+        if (seen >= rank) {
+            return GetBucketLimit(bucket);
+        }
+    }
+    return GetBucketLimit(LATENCY_BUCKET_COUNT - 1);
+}
+
+std::chrono::nanoseconds LatencyHistogram::GetMax() const {
+    return GetPercentile(1.0);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Counts of durations in log-linear buckets, in the manner of HDR histograms:
+// every power of two is split into 2^LATENCY_SUB_BUCKET_BITS equal buckets, so
+// a bucket is at most 1/32 (about 3%) wider than the values it holds, from a
+// nanosecond to LATENCY_MAX_EXPONENT. Longer durations share the last bucket.
+const int LATENCY_SUB_BUCKET_BITS = 5;
+// 2^40 ns is about 18 minutes
+const int LATENCY_MAX_EXPONENT = 40;
+const size_t LATENCY_BUCKET_COUNT = size_t{LATENCY_MAX_EXPONENT - LATENCY_SUB_BUCKET_BITS + 1} << LATENCY_SUB_BUCKET_BITS;
+
+class LatencyHistogram {
+public:
+    static size_t GetBucket(std::chrono::nanoseconds latency);
+    // Largest duration that falls into the bucket
+    static std::chrono::nanoseconds GetBucketLimit(size_t bucket);
+
+    void Add(std::chrono::nanoseconds latency) {
+        ++counts_[GetBucket(latency)];
+        ++count_;
+    }
+
+    void AddToBucket(size_t bucket, uint64_t count) {
+        counts_[bucket] += count;
+        count_ += count;
+    }
+
+    uint64_t GetCount() const {
+        return count_;
+    }
+
+    // Upper limit of the bucket holding the given fraction of durations at or
+    // below it, such as 0.99 for p99; zero if there are none
+    std::chrono::nanoseconds GetPercentile(double fraction) const;
+    std::chrono::nanoseconds GetMax() const;
+
+private:
+    std::array<uint64_t, LATENCY_BUCKET_COUNT> counts_ = {};
+    uint64_t count_ = 0;
+};
@@ -10,10 +10,6 @@
 #include <future>
 #include <shared_mutex>
 
-#include "log_duration.h"
-#include "test_framework.h"
-#include "test_runner.h"
-#include "test_example_functions.h"
 #include "process_queries.h"
 #include "search_server.h"
 #include <execution>
@@ -52,7 +48,7 @@ int main() {
     }
     cout << "Even ids:"s << endl;
     // параллельная версия
-    for (const Document& document : search_server.FindTopDocuments(execution::par, "curly nasty cat"s, [](int document_id, DocumentStatus status, int rating) { return document_id % 2 == 0; })) {
+    for (const Document& document : search_server.FindTopDocuments(execution::par, "curly nasty cat"s, [](int document_id, DocumentStatus, int) { return document_id % 2 == 0; })) {
         PrintDocument(document);
     }
     return 0;
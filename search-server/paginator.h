@@ -1,5 +1,6 @@
 #pragma once
 #include <cassert>
+#include <iterator>
 #include <vector>
 #include <iostream>
 #include "document.h"
@@ -11,7 +12,7 @@ public:
     IteratorRange(Iterator begin, Iterator end)
         : first_(begin)
         , last_(end)
-        , size_(distance(first_, last_)) {
+        , size_(std::distance(first_, last_)) {
     }
 
     Iterator begin() const {
@@ -44,9 +45,9 @@ class Paginator {
 public:
     Paginator(Iterator begin, Iterator end, size_t page_size) {
     assert(end >= begin && page_size > 0);
-        for (size_t left = distance(begin, end); left > 0;) {
+        for (size_t left = std::distance(begin, end); left > 0;) {
             const size_t current_page_size = std::min(page_size, left);
-            const Iterator current_page_end = next(begin, current_page_size);
+            const Iterator current_page_end = std::next(begin, current_page_size);
             pages_.push_back({begin, current_page_end});
 
             left -= current_page_size;
@@ -0,0 +1,172 @@
+#include "posting_list.h"
+#include <algorithm>
+#include "stream_vbyte.h"
+
+void PostingList::Add(uint32_t ordinal, uint32_t count, double term_freq) {
+    AppendPosting(ordinal, count);
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+}
+
+size_t PostingList::Purge(const DocumentBitmap& removed) {
+    PostingList kept;
+    kept.Append(GetView(), removed);
+    const size_t purged = size_ - kept.size_;
+    if (purged > 0) {
+        *this = std::move(kept);
+    }
+    return purged;
+}
+
+void PostingList::Append(const View& other, const DocumentBitmap& removed) {
+    uint32_t ordinals[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    for (size_t block = 0; block < other.block_count; ++block) {
+        const Block& header = other.blocks[block];
+        // Blocks are encoded independently, so a full block with nothing to
+        // drop is copied without decoding. Postings already in the tail become
+        // a short block of their own.
+        if (header.size == BLOCK_SIZE && !removed.ContainsAnyIn(header.first_ordinal, header.last_ordinal)) {
+            Seal();
+            const size_t end = block + 1 < other.block_count ? other.blocks[block + 1].offset : other.data_size;
+            blocks_.push_back({ header.first_ordinal, header.last_ordinal, static_cast<uint32_t>(data_.size()), header.size });
+            data_.insert(data_.end(), other.data + header.offset, other.data + end);
+            size_ += header.size;
+            continue;
+        }
+        other.DecodeBlock(block, ordinals, counts);
+        for (size_t i = 0; i < header.size; ++i) {
+            if (!removed.Contains(ordinals[i])) {
+                AppendPosting(ordinals[i], counts[i]);
+            }
+        }
+    }
+    for (size_t i = 0; i < other.tail_size; ++i) {
+        if (!removed.Contains(other.tail_ordinals[i])) {
+            AppendPosting(other.tail_ordinals[i], other.tail_counts[i]);
+        }
+    }
+    max_term_freq_ = std::max(max_term_freq_, other.max_term_freq);
+}
+
+bool PostingList::Contains(uint32_t ordinal) const {
+    return GetView().Contains(ordinal);
+}
+
+PostingList::View PostingList::GetView() const {
+    return { blocks_.data(), blocks_.size(), data_.data(), data_.size(),
+             tail_ordinals_.data(), tail_counts_.data(), tail_ordinals_.size(), size_, max_term_freq_ };
+}
+
+void PostingList::Seal() {
+    if (tail_ordinals_.empty()) {
+        return;
+    }
+    const size_t size = tail_ordinals_.size();
+    const size_t offset = data_.size();
+    blocks_.push_back({ tail_ordinals_.front(), tail_ordinals_.back(), static_cast<uint32_t>(offset), static_cast<uint32_t>(size) });
+    // Encoded on the stack so data_ only grows by the bytes actually used
+    uint8_t bytes[2 * StreamVByteMaxBytes(BLOCK_SIZE)];
+    size_t length = EncodeStreamVByteDeltas(tail_ordinals_.data(), size, tail_ordinals_.front(), bytes);
+    length += EncodeStreamVByte(tail_counts_.data(), size, bytes + length);
+    data_.insert(data_.end(), bytes, bytes + length);
+    tail_ordinals_.clear();
+    tail_counts_.clear();
+}
+
+void PostingList::ShrinkToFit() {
+    Seal();
+    blocks_.shrink_to_fit();
+    data_.shrink_to_fit();
+    tail_ordinals_ = {};
+    tail_counts_ = {};
+}
+
+size_t PostingList::GetMemoryUsage() const {
+    return sizeof(*this)
+        + blocks_.capacity() * sizeof(Block)
+        + data_.capacity()
+        + (tail_ordinals_.capacity() + tail_counts_.capacity()) * sizeof(uint32_t);
+}
+
+bool PostingList::View::Contains(uint32_t ordinal) const {
+    Cursor cursor(*this, ordinal);
+    return !cursor.AtEnd() && cursor.GetOrdinal() == ordinal;
+}
+
+size_t PostingList::View::FindBlock(uint32_t ordinal) const {
+    return std::partition_point(blocks, blocks + block_count, [ordinal](const Block& block) {
+        return block.last_ordinal < ordinal;
+    }) - blocks;
+}
+
+void PostingList::View::DecodeBlock(size_t block, uint32_t* ordinals, uint32_t* counts) const {
+    const Block& header = blocks[block];
+    const uint8_t* bytes = data + header.offset;
+    bytes += DecodeStreamVByteDeltas(bytes, header.size, header.first_ordinal, ordinals);
+    DecodeStreamVByte(bytes, header.size, counts);
+}
+
+void PostingList::AppendPosting(uint32_t ordinal, uint32_t count) {
+    if (tail_ordinals_.size() == BLOCK_SIZE) {
+        Seal();
+    }
+    tail_ordinals_.push_back(ordinal);
+    tail_counts_.push_back(count);
+    ++size_;
+}
+
+PostingList::Cursor::Cursor(const View& postings, uint32_t first_ordinal, uint32_t last_ordinal)
+    : postings_(postings)
+    , last_ordinal_(last_ordinal)
+{
+    LoadBlock(postings.FindBlock(first_ordinal));
+    SeekTo(first_ordinal);
+}
+
+PostingList::Cursor::Cursor(const PostingList& postings, uint32_t first_ordinal, uint32_t last_ordinal)
+    : Cursor(postings.GetView(), first_ordinal, last_ordinal)
+{
+}
+
+void PostingList::Cursor::SeekTo(uint32_t ordinal) {
+    if (AtEnd() || ordinals_[pos_] >= ordinal) {
+        return;
+    }
+    if (ordinals_[size_ - 1] < ordinal) {
+        if (last_block_) {
+            pos_ = size_;
+            return;
+        }
+        const Block* blocks = postings_.blocks;
+        const Block* next = std::partition_point(blocks + block_ + 1, blocks + postings_.block_count,
+            [ordinal](const Block& block) {
+                return block.last_ordinal < ordinal;
+            });
+        LoadBlock(next - blocks);
+        if (AtEnd()) {
+            return;
+        }
+    }
+    pos_ = std::lower_bound(ordinals_ + pos_, ordinals_ + size_, ordinal) - ordinals_;
+}
+
+void PostingList::Cursor::LoadBlock(size_t block) {
+    block_ = block;
+    pos_ = 0;
+    if (block < postings_.block_count) {
+        size_ = postings_.blocks[block].size;
+        last_block_ = false;
+        postings_.DecodeBlock(block, ordinals_, counts_);
+    } else {
+        size_ = postings_.tail_size;
+        last_block_ = true;
+        std::copy(postings_.tail_ordinals, postings_.tail_ordinals + size_, ordinals_);
+        std::copy(postings_.tail_counts, postings_.tail_counts + size_, counts_);
+    }
+    // Postings at or past last_ordinal_ are outside the cursor's range
+    const size_t in_range = std::lower_bound(ordinals_, ordinals_ + size_, last_ordinal_) - ordinals_;
+    if (in_range < size_) {
+        size_ = in_range;
+        last_block_ = true;
+    }
+}
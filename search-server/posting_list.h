@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "document_bitmap.h"
+
+// Documents containing one term, sorted by internal document ordinal. Each
+// posting stores how many times the term occurs in the document.
+//
+// Postings are packed into blocks of up to BLOCK_SIZE entries: ordinals are
+// delta-encoded and both ordinals and counts are Stream VByte compressed. The
+// newest postings stay uncompressed in a tail until it fills up a block.
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    struct Block {
+        uint32_t first_ordinal;
+        uint32_t last_ordinal;
+        // Start of the block in the list's data: encoded ordinal deltas, then encoded counts
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    // Read-only postings that need not belong to a PostingList: sealed segments
+    // keep all of theirs in flat arrays, possibly inside a mapped snapshot
+    struct View {
+        const Block* blocks = nullptr;
+        size_t block_count = 0;
+        const uint8_t* data = nullptr;
+        size_t data_size = 0;
+        const uint32_t* tail_ordinals = nullptr;
+        const uint32_t* tail_counts = nullptr;
+        size_t tail_size = 0;
+        size_t size = 0;
+        double max_term_freq = 0.0;
+
+        bool empty() const {
+            return size == 0;
+        }
+
+        bool Contains(uint32_t ordinal) const;
+        // First block whose last ordinal is >= the given one, or block_count
+        size_t FindBlock(uint32_t ordinal) const;
+        void DecodeBlock(size_t block, uint32_t* ordinals, uint32_t* counts) const;
+    };
+
+    // The ordinal must be greater than any ordinal already in the list.
+    // term_freq is only used to keep GetMaxTermFreq up to date.
+    void Add(uint32_t ordinal, uint32_t count, double term_freq);
+
+    // Rewrites the list without the postings of `removed` documents;
+    // returns how many postings were dropped
+    size_t Purge(const DocumentBitmap& removed);
+
+    // Appends the postings of `other`, whose ordinals must all follow this
+    // list's, except those of `removed` documents
+    void Append(const View& other, const DocumentBitmap& removed);
+
+    bool Contains(uint32_t ordinal) const;
+
+    // Valid until the list changes
+    View GetView() const;
+
+    // Compresses the tail even if it does not fill a whole block
+    void Seal();
+
+    // Seals the list and releases spare capacity; for lists that stop growing
+    void ShrinkToFit();
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Upper bound of the term frequencies; not lowered by Purge, so it may overestimate
+    double GetMaxTermFreq() const {
+        return max_term_freq_;
+    }
+
+    size_t GetMemoryUsage() const;
+
+    // Walks the postings of [first_ordinal, last_ordinal) in order, one decoded block at a time
+    class Cursor {
+    public:
+        explicit Cursor(const View& postings, uint32_t first_ordinal = 0, uint32_t last_ordinal = UINT32_MAX);
+        explicit Cursor(const PostingList& postings, uint32_t first_ordinal = 0, uint32_t last_ordinal = UINT32_MAX);
+
+        bool AtEnd() const {
+            return pos_ == size_;
+        }
+
+        uint32_t GetOrdinal() const {
+            return ordinals_[pos_];
+        }
+
+        uint32_t GetCount() const {
+            return counts_[pos_];
+        }
+
+        void Next() {
+            if (++pos_ == size_ && !last_block_) {
+                LoadBlock(block_ + 1);
+            }
+        }
+
+        // Moves to the first posting with ordinal >= the given one, skipping whole blocks
+        void SeekTo(uint32_t ordinal);
+
+    private:
+        View postings_;
+        uint32_t last_ordinal_;
+        // postings_.block_count stands for the tail
+        size_t block_ = 0;
+        size_t pos_ = 0;
+        size_t size_ = 0;
+        // Set for the tail and for a block cut short by last_ordinal_
+        bool last_block_ = false;
+        uint32_t ordinals_[BLOCK_SIZE];
+        uint32_t counts_[BLOCK_SIZE];
+
+        void LoadBlock(size_t block);
+    };
+
+private:
+    std::vector<Block> blocks_;
+    std::vector<uint8_t> data_;
+    std::vector<uint32_t> tail_ordinals_;
+    std::vector<uint32_t> tail_counts_;
+    size_t size_ = 0;
+    double max_term_freq_ = 0.0;
+
+    void AppendPosting(uint32_t ordinal, uint32_t count);
+};
@@ -1,22 +1,50 @@
-#include <execution>
+#include <algorithm>
+#include <iterator>
 
 #include "process_queries.h"
 
+namespace {
+
+QueryExecutor& GetSharedExecutor() {
+    static QueryExecutor executor;
+    return executor;
+}
+
+} // namespace
+
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries){
-    std::vector<std::vector<Document>> result(queries.size());
-    std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(), [&search_server](auto &query){
-        return search_server.FindTopDocuments(query);
-    });
-    return result;
+    return ProcessQueries(GetSharedExecutor(), search_server, queries);
+}
+std::vector<std::vector<Document>> ProcessQueries(
+    QueryExecutor& executor,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries){
+    return executor.Process(search_server, queries);
 }
 std::vector<Document> ProcessQueriesJoined(const SearchServer& search_server, const std::vector<std::string>& queries){
     std::vector<Document> result;
-    for(auto& process : ProcessQueries(search_server, queries)){
-        std::transform(process.begin(), process.end(), back_inserter(result), [](Document doc){
-        return doc;
+    GetSharedExecutor().Stream(search_server, queries, STREAM_WINDOW_SIZE, [&result](size_t, std::vector<Document>&& documents){
+        std::move(documents.begin(), documents.end(), back_inserter(result));
     });
-    }
     return result;
-}
\ No newline at end of file
+}
+void ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    const std::function<void(const Document&)>& sink){
+    ProcessQueriesJoined(GetSharedExecutor(), search_server, queries, STREAM_WINDOW_SIZE, sink);
+}
+void ProcessQueriesJoined(
+    QueryExecutor& executor,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    size_t window_size,
+    const std::function<void(const Document&)>& sink){
+    executor.Stream(search_server, queries, window_size, [&sink](size_t, std::vector<Document>&& documents){
+        for (const Document& document : documents) {
+            sink(document);
+        }
+    });
+}
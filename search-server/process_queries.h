@@ -1,15 +1,37 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <vector>
 
+#include "query_executor.h"
 #include "search_server.h"
 
 
+// Runs on a QueryExecutor shared by the process, with one thread per hardware thread
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries); 
 
+std::vector<std::vector<Document>> ProcessQueries(
+    QueryExecutor& executor,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string>& queries); 
\ No newline at end of file
+    const std::vector<std::string>& queries);
+
+// Hands the documents of every query to the sink in query order, without
+// keeping the results of the whole batch; see QueryExecutor::Stream
+void ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    const std::function<void(const Document&)>& sink);
+
+void ProcessQueriesJoined(
+    QueryExecutor& executor,
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    size_t window_size,
+    const std::function<void(const Document&)>& sink);
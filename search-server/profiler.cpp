@@ -0,0 +1,143 @@
+#include "profiler.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "latency_histogram.h"
+
+namespace {
+
+const std::string_view STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+    "parse_query", "filtering", "posting_lookup", "scoring", "top_k",
+    "result_build", "add_document", "add_documents", "remove_document", "compaction",
+};
+
+// Timings of one thread. Only the owning thread writes, so plain loads and
+// stores of relaxed atomics are enough.
+struct ThreadProfile {
+    std::atomic<uint64_t> total_ns[PROFILE_STAGE_COUNT];
+    std::atomic<uint64_t> counts[PROFILE_STAGE_COUNT][LATENCY_BUCKET_COUNT];
+
+    ThreadProfile() {
+        Reset();
+    }
+
+    void Reset() {
+        for (auto& total : total_ns) {
+            total.store(0, std::memory_order_relaxed);
+        }
+        for (auto& stage_counts : counts) {
+            for (auto& count : stage_counts) {
+                count.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadProfile>> profiles;
+    // Profiles of exited threads, handed to new ones with their timings kept
+    std::vector<ThreadProfile*> free_profiles;
+};
+
+Registry& GetRegistry() {
+    // Never destroyed, so threads still running at exit can record
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+class ThreadProfileHandle {
+public:
+    ThreadProfileHandle() {
+        Registry& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        if (!registry.free_profiles.empty()) {
+            profile_ = registry.free_profiles.back();
+            registry.free_profiles.pop_back();
+        } else {
+            profile_ = registry.profiles.emplace_back(std::make_unique<ThreadProfile>()).get();
+        }
+    }
+
+    ~ThreadProfileHandle() {
+        Registry& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        registry.free_profiles.push_back(profile_);
+    }
+
+    ThreadProfile& Get() {
+        return *profile_;
+    }
+
+private:
+    ThreadProfile* profile_;
+};
+
+} // namespace
+
+std::string_view GetProfileStageName(ProfileStage stage) {
+    return STAGE_NAMES[static_cast<size_t>(stage)];
+}
+
+void RecordProfileTiming(ProfileStage stage, std::chrono::nanoseconds duration) {
+    const auto add = [](std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    };
+
+    thread_local ThreadProfileHandle handle;
+    ThreadProfile& profile = handle.Get();
+    const size_t index = static_cast<size_t>(stage);
+    add(profile.total_ns[index], static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0)));
+    add(profile.counts[index][LatencyHistogram::GetBucket(duration)], 1);
+}
+
+StageProfile GetStageProfile(ProfileStage stage) {
+    const size_t index = static_cast<size_t>(stage);
+    StageProfile result;
+    LatencyHistogram durations;
+    Registry& registry = GetRegistry();
+    {
+        std::lock_guard guard(registry.mutex);
+        for (const auto& profile : registry.profiles) {
+            result.total += std::chrono::nanoseconds(profile->total_ns[index].load(std::memory_order_relaxed));
+            for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+                if (const uint64_t count = profile->counts[index][bucket].load(std::memory_order_relaxed)) {
+                    durations.AddToBucket(bucket, count);
+                }
+            }
+        }
+    }
+    result.count = durations.GetCount();
+    result.p50 = durations.GetPercentile(0.50);
+    result.p95 = durations.GetPercentile(0.95);
+    result.p99 = durations.GetPercentile(0.99);
+    result.max = durations.GetMax();
+    return result;
+}
+
+void WriteProfile(std::ostream& output) {
+    output << '{';
+    for (size_t index = 0; index < PROFILE_STAGE_COUNT; ++index) {
+        const ProfileStage stage = static_cast<ProfileStage>(index);
+        const StageProfile profile = GetStageProfile(stage);
+        output << (index == 0 ? "" : ",")
+               << '"' << GetProfileStageName(stage) << "\":{"
+               << "\"count\":" << profile.count
+               << ",\"total_ns\":" << profile.total.count()
+               << ",\"p50_ns\":" << profile.p50.count()
+               << ",\"p95_ns\":" << profile.p95.count()
+               << ",\"p99_ns\":" << profile.p99.count()
+               << ",\"max_ns\":" << profile.max.count() << '}';
+    }
+    output << "}\n";
+}
+
+void ResetProfile() {
+    Registry& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    for (const auto& profile : registry.profiles) {
+        profile->Reset();
+    }
+}
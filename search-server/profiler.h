@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+// Stages of the query and indexing paths timed by PROFILE_STAGE. Stages never
+// nest, so the time of a query is the sum of its stages.
+enum class ProfileStage {
+    PARSE_QUERY,
+    // Minus words and the status bitmap
+    FILTERING,
+    // Finding the posting lists of the plus words
+    POSTING_LOOKUP,
+    // Walking the posting lists; in MAX_SCORE mode this keeps the top as well
+    SCORING,
+    TOP_K,
+    // Sorting the top and merging the tops of parallel parts
+    RESULT_BUILD,
+    ADD_DOCUMENT,
+    // AddDocuments, per batch
+    ADD_DOCUMENTS,
+    REMOVE_DOCUMENT,
+    // Purging removed documents from the index
+    COMPACTION,
+};
+const size_t PROFILE_STAGE_COUNT = 10;
+
+struct StageProfile {
+    uint64_t count = 0;
+    std::chrono::nanoseconds total{0};
+    std::chrono::nanoseconds p50{0};
+    std::chrono::nanoseconds p95{0};
+    std::chrono::nanoseconds p99{0};
+    std::chrono::nanoseconds max{0};
+};
+
+std::string_view GetProfileStageName(ProfileStage stage);
+
+void RecordProfileTiming(ProfileStage stage, std::chrono::nanoseconds duration);
+
+// Timings of a stage recorded by all threads since the start or the last reset
+StageProfile GetStageProfile(ProfileStage stage);
+// Every stage as one JSON object keyed by stage name
+void WriteProfile(std::ostream& output);
+// Timings recorded while it runs may survive the reset
+void ResetProfile();
+
+// Times its own lifetime as one run of the stage
+class ProfileScope {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ProfileScope(ProfileStage stage)
+        : stage_(stage)
+        , start_time_(Clock::now())
+    {
+    }
+
+    ~ProfileScope() {
+        RecordProfileTiming(stage_, Clock::now() - start_time_);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    ProfileStage stage_;
+    Clock::time_point start_time_;
+};
+
+#define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
+#define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
+
+// Times the rest of the enclosing block. Compiled out unless the build defines
+// SEARCH_SERVER_PROFILING.
+#ifdef SEARCH_SERVER_PROFILING
+#define PROFILE_STAGE(stage) const ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(stage)
+#else
+#define PROFILE_STAGE(stage) static_cast<void>(0)
+#endif
@@ -0,0 +1,270 @@
+#include "query_executor.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <pthread.h>
+#include <sched.h>
+
+namespace {
+
+// Runs per worker a batch is cut into; more runs balance better, fewer cost less to queue
+const size_t TASKS_PER_WORKER = 8;
+
+} // namespace
+
+struct QueryExecutor::Batch {
+    const SearchServer* search_server;
+    // Set when the executor holds the queries itself
+    std::vector<std::string> owned_queries;
+    const std::vector<std::string>* queries;
+    // Query i goes to results[i % results.size()]; a stream reuses the slots of delivered results
+    std::vector<std::vector<Document>> results;
+    // Tasks not yet finished
+    std::atomic<size_t> remaining_task_count{0};
+    std::mutex mutex;
+    std::exception_ptr error;
+    std::promise<std::vector<std::vector<Document>>> done;
+
+    // Only for Stream
+    bool streaming = false;
+    std::vector<uint8_t> ready;
+    std::condition_variable progress;
+};
+
+QueryExecutor::QueryExecutor(QueryExecutorOptions options)
+    : share_postings_(options.share_postings)
+{
+    const size_t thread_count = options.thread_count > 0
+        ? options.thread_count
+        : std::max(1u, std::thread::hardware_concurrency());
+    for (const int cpu : options.cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            throw std::invalid_argument("Invalid CPU " + std::to_string(cpu));
+        }
+    }
+
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_[i]->thread = std::thread([this, i] {
+            RunWorker(i);
+        });
+        if (!options.cpus.empty()) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(options.cpus[i % options.cpus.size()], &cpus);
+            if (pthread_setaffinity_np(workers_[i]->thread.native_handle(), sizeof(cpus), &cpus) != 0) {
+                Stop();
+                throw std::invalid_argument("Cannot run on CPU " + std::to_string(options.cpus[i % options.cpus.size()]));
+            }
+        }
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    Stop();
+}
+
+size_t QueryExecutor::GetThreadCount() const {
+    return workers_.size();
+}
+
+std::vector<std::vector<Document>> QueryExecutor::Process(const SearchServer& search_server, const std::vector<std::string>& queries) {
+    auto batch = std::make_shared<Batch>();
+    batch->search_server = &search_server;
+    batch->queries = &queries;
+    return Enqueue(std::move(batch)).get();
+}
+
+std::future<std::vector<std::vector<Document>>> QueryExecutor::Submit(const SearchServer& search_server, std::vector<std::string> queries) {
+    auto batch = std::make_shared<Batch>();
+    batch->search_server = &search_server;
+    batch->owned_queries = std::move(queries);
+    batch->queries = &batch->owned_queries;
+    return Enqueue(std::move(batch));
+}
+
+void QueryExecutor::Stream(const SearchServer& search_server, const std::vector<std::string>& queries, size_t window_size,
+                           const std::function<void(size_t, std::vector<Document>&&)>& sink) {
+    const size_t query_count = queries.size();
+    window_size = std::clamp<size_t>(window_size, 1, std::max<size_t>(query_count, 1));
+    auto batch = std::make_shared<Batch>();
+    batch->search_server = &search_server;
+    batch->queries = &queries;
+    batch->results.resize(window_size);
+    batch->streaming = true;
+    batch->ready.resize(window_size);
+    // Runs small enough that every worker has several of them in a full window
+    const size_t run_size = std::max<size_t>(1, window_size / (workers_.size() * TASKS_PER_WORKER));
+
+    // Tasks still in flight point into `queries`, so they must end before this
+    // returns. The error is taken out of the batch, so the worker that drops
+    // the batch last does not share it with the caller.
+    auto finish_tasks = [&batch] {
+        std::unique_lock lock(batch->mutex);
+        batch->progress.wait(lock, [&batch] {
+            return batch->remaining_task_count == 0;
+        });
+        return std::exchange(batch->error, nullptr);
+    };
+
+    size_t submitted_count = 0;
+    for (size_t delivered_count = 0; delivered_count < query_count; ++delivered_count) {
+        // Queries run ahead of the sink by at most window_size
+        const size_t window_end = std::min(delivered_count + window_size, query_count);
+        if (submitted_count < window_end && (window_end - submitted_count >= run_size || window_end == query_count)) {
+            const size_t run_count = (window_end - submitted_count + run_size - 1) / run_size;
+            Enqueue(batch, submitted_count, window_end, run_count);
+            submitted_count = window_end;
+        }
+
+        const size_t slot = delivered_count % window_size;
+        {
+            std::unique_lock lock(batch->mutex);
+            batch->progress.wait(lock, [&batch, slot] {
+                return batch->ready[slot] || batch->error;
+            });
+            if (batch->error) {
+                lock.unlock();
+                std::rethrow_exception(finish_tasks());
+            }
+            batch->ready[slot] = false;
+        }
+        try {
+            sink(delivered_count, std::move(batch->results[slot]));
+        } catch (...) {
+            finish_tasks();
+            throw;
+        }
+        batch->results[slot] = {};
+    }
+}
+
+std::future<std::vector<std::vector<Document>>> QueryExecutor::Enqueue(std::shared_ptr<Batch> batch) {
+    auto result = batch->done.get_future();
+    const size_t query_count = batch->queries->size();
+    batch->results.resize(query_count);
+    if (query_count == 0) {
+        batch->done.set_value({});
+        return result;
+    }
+    Enqueue(std::move(batch), 0, query_count, std::min(query_count, workers_.size() * TASKS_PER_WORKER));
+    return result;
+}
+
+void QueryExecutor::Enqueue(const std::shared_ptr<Batch>& batch, size_t first, size_t last, size_t task_count) {
+    const size_t worker_count = workers_.size();
+    const size_t query_count = last - first;
+    batch->remaining_task_count += task_count;
+    {
+        // Raised before the tasks appear, so a worker that sees the count may spin
+        // briefly but never sleeps while a task is queued
+        std::lock_guard guard(mutex_);
+        queued_task_count_ += task_count;
+    }
+    // Neighbouring runs go to the same worker while its queue lasts
+    const size_t first_worker = next_worker_.fetch_add(1) % worker_count;
+    for (size_t task = 0; task < task_count; ++task) {
+        Worker& worker = *workers_[(first_worker + task * worker_count / task_count) % worker_count];
+        std::lock_guard guard(worker.mutex);
+        worker.tasks.push_back({batch, first + query_count * task / task_count, first + query_count * (task + 1) / task_count});
+    }
+    work_available_.notify_all();
+}
+
+void QueryExecutor::RunWorker(size_t index) {
+    Task task;
+    while (true) {
+        if (TakeTask(index, task)) {
+            RunTask(task);
+            task.batch.reset();
+            continue;
+        }
+        std::unique_lock lock(mutex_);
+        work_available_.wait(lock, [this] {
+            return stopping_ || queued_task_count_ > 0;
+        });
+        if (stopping_ && queued_task_count_ == 0) {
+            return;
+        }
+    }
+}
+
+bool QueryExecutor::TakeTask(size_t index, Task& task) {
+    {
+        Worker& own = *workers_[index];
+        std::lock_guard guard(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            --queued_task_count_;
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < workers_.size(); ++offset) {
+        Worker& victim = *workers_[(index + offset) % workers_.size()];
+        std::lock_guard guard(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            --queued_task_count_;
+            return true;
+        }
+    }
+    return false;
+}
+
+void QueryExecutor::RunTask(const Task& task) const {
+    Batch& batch = *task.batch;
+    try {
+        if (share_postings_) {
+            const std::vector<std::string_view> queries(batch.queries->begin() + task.first, batch.queries->begin() + task.last);
+            auto results = batch.search_server->FindTopDocumentsBatch(queries);
+            for (size_t i = task.first; i < task.last; ++i) {
+                batch.results[i % batch.results.size()] = std::move(results[i - task.first]);
+            }
+        } else {
+            for (size_t i = task.first; i < task.last; ++i) {
+                batch.results[i % batch.results.size()] = batch.search_server->FindTopDocuments((*batch.queries)[i]);
+            }
+        }
+    } catch (...) {
+        std::lock_guard guard(batch.mutex);
+        if (!batch.error) {
+            batch.error = std::current_exception();
+        }
+    }
+    if (batch.streaming) {
+        {
+            std::lock_guard guard(batch.mutex);
+            for (size_t i = task.first; i < task.last; ++i) {
+                batch.ready[i % batch.ready.size()] = true;
+            }
+            --batch.remaining_task_count;
+        }
+        batch.progress.notify_all();
+        return;
+    }
+    if (--batch.remaining_task_count == 0) {
+        if (batch.error) {
+            batch.done.set_exception(batch.error);
+        } else {
+            batch.done.set_value(std::move(batch.results));
+        }
+    }
+}
+
+void QueryExecutor::Stop() {
+    {
+        std::lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    work_available_.notify_all();
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "search_server.h"
+
+// Results QueryExecutor::Stream computes ahead of its sink by default
+const size_t STREAM_WINDOW_SIZE = 4096;
+
+struct QueryExecutorOptions {
+    // Worker threads; 0 uses one per hardware thread
+    size_t thread_count = 0;
+    // Worker i runs only on CPU cpus[i % cpus.size()]; empty leaves placement to the system
+    std::vector<int> cpus;
+    // Each run of queries is scored with SearchServer::FindTopDocumentsBatch,
+    // which reads a posting list once for all queries of the run that need it.
+    // Pays off when queries share many words.
+    bool share_postings = false;
+};
+
+// Persistent pool of threads that answers batches of queries with
+// FindTopDocuments. A batch is cut into runs of queries spread over the
+// workers' queues; a worker whose queue runs dry steals runs from the back of
+// the others', so one slow query does not hold up a whole share of the batch.
+//
+// Workers live as long as the executor, so each keeps its scoring scratch
+// (SearchServer's per-thread RelevanceAccumulator) warm across queries and
+// batches. Batches may be submitted from several threads and overlap.
+class QueryExecutor {
+public:
+    // Throws std::invalid_argument if a CPU cannot be used
+    explicit QueryExecutor(QueryExecutorOptions options = {});
+    // Finishes the batches already submitted
+    ~QueryExecutor();
+
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    size_t GetThreadCount() const;
+
+    // Results in query order. If a query throws, the first exception is rethrown
+    // once the batch is done. The server must not change until then.
+    std::vector<std::vector<Document>> Process(const SearchServer& search_server, const std::vector<std::string>& queries);
+
+    // Queues a batch and returns at once, so the next batch can be prepared
+    // while this one runs
+    std::future<std::vector<std::vector<Document>>> Submit(const SearchServer& search_server, std::vector<std::string> queries);
+
+    // Calls sink(query_index, documents) on the calling thread for every query
+    // in order, as soon as its result and those before it are ready. Workers run
+    // at most window_size queries ahead of the sink and wait for it beyond that,
+    // so memory does not grow with the batch. If a query or the sink throws,
+    // the exception is rethrown once the queries already started are done.
+    void Stream(const SearchServer& search_server, const std::vector<std::string>& queries, size_t window_size,
+                const std::function<void(size_t, std::vector<Document>&&)>& sink);
+
+private:
+    struct Batch;
+
+    // Queries [first, last) of one batch
+    struct Task {
+        std::shared_ptr<Batch> batch;
+        size_t first;
+        size_t last;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        // The owner takes tasks from the front, thieves from the back
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    bool share_postings_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::mutex mutex_;
+    std::condition_variable work_available_;
+    // Tasks queued and not yet taken; only raised under mutex_
+    std::atomic<size_t> queued_task_count_{0};
+    bool stopping_ = false;
+    // Worker that gets the first task of the next batch
+    std::atomic<size_t> next_worker_{0};
+
+    std::future<std::vector<std::vector<Document>>> Enqueue(std::shared_ptr<Batch> batch);
+    // Queues queries [first, last) of the batch as task_count runs
+    void Enqueue(const std::shared_ptr<Batch>& batch, size_t first, size_t last, size_t task_count);
+    void RunWorker(size_t index);
+    bool TakeTask(size_t index, Task& task);
+    void RunTask(const Task& task) const;
+    void Stop();
+};
@@ -0,0 +1,215 @@
+#include "query_result_cache.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+const uint8_t MAX_FREQUENCY = 15;
+const size_t SKETCH_ROW_COUNT = 4;
+const uint64_t SKETCH_SEEDS[SKETCH_ROW_COUNT] = {
+    0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull, 0xd6e8feb86659fd93ull,
+};
+
+// Approximate recent request counts of key hashes (a count-min sketch). All
+// counts are halved every few requests per counter, so old popularity fades.
+class FrequencySketch {
+public:
+    explicit FrequencySketch(size_t width)
+        : width_(width)
+        , counters_(SKETCH_ROW_COUNT * width)
+        , reset_period_(10 * width)
+    {
+    }
+
+    void Increment(uint64_t hash) {
+        for (size_t row = 0; row < SKETCH_ROW_COUNT; ++row) {
+            uint8_t& counter = counters_[GetIndex(hash, row)];
+            if (counter < MAX_FREQUENCY) {
+                ++counter;
+            }
+        }
+        if (++increment_count_ == reset_period_) {
+            for (uint8_t& counter : counters_) {
+                counter /= 2;
+            }
+            increment_count_ = 0;
+        }
+    }
+
+    uint8_t Estimate(uint64_t hash) const {
+        uint8_t frequency = MAX_FREQUENCY;
+        for (size_t row = 0; row < SKETCH_ROW_COUNT; ++row) {
+            frequency = std::min(frequency, counters_[GetIndex(hash, row)]);
+        }
+        return frequency;
+    }
+
+private:
+    // Power of two
+    size_t width_;
+    std::vector<uint8_t> counters_;
+    size_t reset_period_;
+    size_t increment_count_ = 0;
+
+    size_t GetIndex(uint64_t hash, size_t row) const {
+        return row * width_ + (((hash ^ SKETCH_SEEDS[row]) * SKETCH_SEEDS[(row + 1) % SKETCH_ROW_COUNT]) >> 32 & (width_ - 1));
+    }
+};
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+        result *= 2;
+    }
+    return result;
+}
+
+} // namespace
+
+struct QueryResultCache::Shard {
+    struct Entry {
+        std::string key;
+        uint64_t hash;
+        std::vector<Document> documents;
+        size_t bytes;
+    };
+
+    // Node sizes of the list and the index, roughly
+    static constexpr size_t ENTRY_OVERHEAD = sizeof(Entry) + 80;
+
+    std::mutex mutex;
+    // Most recently used first
+    std::list<Entry> entries;
+    // Keys point into the entries, which list nodes never move
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index;
+    FrequencySketch sketch;
+    size_t max_bytes;
+    size_t bytes = 0;
+    // Newest epoch seen; every entry has it
+    uint64_t epoch = 0;
+    QueryResultCacheStats stats;
+
+    explicit Shard(size_t max_bytes)
+        : sketch(RoundUpToPowerOfTwo(std::max<size_t>(64, max_bytes / 256)))
+        , max_bytes(max_bytes)
+    {
+    }
+
+    void Erase(std::list<Entry>::iterator entry) {
+        bytes -= entry->bytes;
+        index.erase(entry->key);
+        entries.erase(entry);
+    }
+
+    void EraseAll() {
+        stats.evictions += entries.size();
+        index.clear();
+        entries.clear();
+        bytes = 0;
+    }
+
+    // Drops the entries of older epochs; returns false if `new_epoch` is outdated itself
+    bool UpdateEpoch(uint64_t new_epoch) {
+        if (new_epoch < epoch) {
+            return false;
+        }
+        if (new_epoch > epoch) {
+            EraseAll();
+            epoch = new_epoch;
+        }
+        return true;
+    }
+};
+
+QueryResultCache::QueryResultCache(QueryResultCacheOptions options) {
+    const size_t shard_count = std::max<size_t>(1, options.shard_count);
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<Shard>(options.max_bytes / shard_count));
+    }
+}
+
+QueryResultCache::~QueryResultCache() = default;
+
+bool QueryResultCache::Find(std::string_view key, uint64_t epoch, std::vector<Document>& documents) {
+    const uint64_t hash = std::hash<std::string_view>{}(key);
+    Shard& shard = GetShard(hash);
+    std::lock_guard guard(shard.mutex);
+    shard.sketch.Increment(hash);
+    const auto it = shard.UpdateEpoch(epoch) ? shard.index.find(key) : shard.index.end();
+    if (it == shard.index.end()) {
+        ++shard.stats.misses;
+        return false;
+    }
+    const auto entry = it->second;
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    documents = entry->documents;
+    ++shard.stats.hits;
+    return true;
+}
+
+void QueryResultCache::Insert(std::string_view key, uint64_t epoch, const std::vector<Document>& documents) {
+    const uint64_t hash = std::hash<std::string_view>{}(key);
+    Shard& shard = GetShard(hash);
+    const size_t bytes = Shard::ENTRY_OVERHEAD + key.size() + documents.size() * sizeof(Document);
+    if (bytes > shard.max_bytes) {
+        return;
+    }
+    std::lock_guard guard(shard.mutex);
+    // An outdated result, or another thread got here first
+    if (!shard.UpdateEpoch(epoch) || shard.index.count(key) > 0) {
+        return;
+    }
+
+    // Entries are evicted only for a query requested more often than they are
+    const uint8_t frequency = shard.sketch.Estimate(hash);
+    size_t freed_bytes = 0;
+    for (auto victim = shard.entries.end(); shard.bytes - freed_bytes + bytes > shard.max_bytes; ) {
+        --victim;
+        if (shard.sketch.Estimate(victim->hash) >= frequency) {
+            ++shard.stats.rejections;
+            return;
+        }
+        freed_bytes += victim->bytes;
+    }
+    while (shard.bytes + bytes > shard.max_bytes) {
+        shard.Erase(std::prev(shard.entries.end()));
+        ++shard.stats.evictions;
+    }
+
+    shard.entries.push_front({ std::string(key), hash, documents, bytes });
+    shard.index.emplace(shard.entries.front().key, shard.entries.begin());
+    shard.bytes += bytes;
+    ++shard.stats.insertions;
+}
+
+void QueryResultCache::Clear() {
+    for (const auto& shard : shards_) {
+        std::lock_guard guard(shard->mutex);
+        shard->EraseAll();
+    }
+}
+
+QueryResultCacheStats QueryResultCache::GetStats() const {
+    QueryResultCacheStats total;
+    for (const auto& shard : shards_) {
+        std::lock_guard guard(shard->mutex);
+        total.hits += shard->stats.hits;
+        total.misses += shard->stats.misses;
+        total.insertions += shard->stats.insertions;
+        total.evictions += shard->stats.evictions;
+        total.rejections += shard->stats.rejections;
+        total.entry_count += shard->entries.size();
+        total.bytes += shard->bytes;
+    }
+    return total;
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(uint64_t hash) const {
+    return *shards_[hash % shards_.size()];
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "document.h"
+
+struct QueryResultCacheOptions {
+    // Memory the entries may take, keys and bookkeeping included
+    size_t max_bytes = 64 << 20;
+    // Separately locked parts; threads looking up different queries rarely wait for each other
+    size_t shard_count = 16;
+};
+
+struct QueryResultCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t insertions = 0;
+    // Entries dropped to make room or because the index changed
+    uint64_t evictions = 0;
+    // Results not cached because the entries they would replace are requested more often
+    uint64_t rejections = 0;
+    size_t entry_count = 0;
+    size_t bytes = 0;
+};
+
+// Query results keyed by the normalized query and the index epoch they were
+// computed at. Epochs must never decrease. Entries of an older epoch cannot be
+// found again, so a shard drops all of them at its first lookup or insertion
+// with a newer epoch; results go stale only if the epoch is not bumped.
+//
+// Each shard keeps its entries in LRU order. A full shard admits a new entry
+// only if a frequency sketch (TinyLFU) has seen its query more often than the
+// queries it would evict, so a burst of one-off queries cannot flush the
+// popular ones. All methods may be called from several threads at once.
+class QueryResultCache {
+public:
+    explicit QueryResultCache(QueryResultCacheOptions options = {});
+    ~QueryResultCache();
+
+    QueryResultCache(const QueryResultCache&) = delete;
+    QueryResultCache& operator=(const QueryResultCache&) = delete;
+
+    // Returns false if there is no entry for the key at this epoch. Nothing is
+    // found or inserted for an epoch older than one seen before.
+    bool Find(std::string_view key, uint64_t epoch, std::vector<Document>& documents);
+    void Insert(std::string_view key, uint64_t epoch, const std::vector<Document>& documents);
+
+    void Clear();
+
+    QueryResultCacheStats GetStats() const;
+
+private:
+    struct Shard;
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    Shard& GetShard(uint64_t hash) const;
+};
@@ -0,0 +1,13 @@
+#include "relevance_accumulator.h"
+
+void RelevanceAccumulator::Reset(size_t document_count) {
+    for (const uint32_t ordinal : touched_) {
+        scores_[ordinal] = 0.0;
+        states_[ordinal] = UNTOUCHED;
+    }
+    touched_.clear();
+    if (scores_.size() < document_count) {
+        scores_.resize(document_count, 0.0);
+        states_.resize(document_count, UNTOUCHED);
+    }
+}
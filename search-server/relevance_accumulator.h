@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Dense relevance scores indexed by internal document ordinal. Only the slots
+// listed in touched() are dirty, so Reset costs O(matched documents), not
+// O(document count), and one instance can be reused for every query.
+class RelevanceAccumulator {
+public:
+    // Drops the previous query's scores and makes ordinals [0, document_count) addressable
+    void Reset(size_t document_count);
+
+    void Add(uint32_t ordinal, double relevance) {
+        uint8_t& state = states_[ordinal];
+        if (state == UNTOUCHED) {
+            state = SCORED;
+            touched_.push_back(ordinal);
+        }
+        scores_[ordinal] += relevance;
+    }
+
+    double GetScore(uint32_t ordinal) const {
+        return scores_[ordinal];
+    }
+
+    const std::vector<uint32_t>& touched() const {
+        return touched_;
+    }
+
+private:
+    enum : uint8_t { UNTOUCHED, SCORED };
+
+    std::vector<double> scores_;
+    std::vector<uint8_t> states_;
+    std::vector<uint32_t> touched_;
+};
@@ -1,31 +1,275 @@
 #include "remove_duplicates.h"
-#include "document.h"
-#include "log_duration.h"
 #include <algorithm>
-#include <iostream>
-#include <map>
-#include <set>
-#include <string>
-#include <vector>
-
-void RemoveDuplicates(SearchServer& search_server) {
-  map<set<string>, int>  remove_;
-  set<int> deleted_;
-  for (auto document_id = search_server.begin(); document_id != search_server.end(); document_id++){
-    set<string> words_;
-    auto lots_of_words_ = search_server.GetWordFrequencies(*document_id);
-    for (auto iterator = lots_of_words_.begin(); iterator != lots_of_words_.end(); iterator++){
-    	words_.insert(iterator->first);
-    }
-    if(remove_.count(words_)){
-    	deleted_.insert(*document_id);
-    }else{
-    	remove_.insert({words_, *document_id});
-    }
-  }
-
-  for(auto id : deleted_){
-          cout << "Found duplicate document id " << id << endl;
-          search_server.RemoveDocument(id);
-      }
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+struct Fingerprint {
+    uint64_t high;
+    uint64_t low;
+
+    bool operator<(const Fingerprint& other) const {
+        return std::tie(high, low) < std::tie(other.high, other.low);
+    }
+
+    bool operator==(const Fingerprint& other) const {
+        return high == other.high && low == other.low;
+    }
+};
+
+// SplitMix64 finalizer
+uint64_t Mix(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+uint64_t GetLowBitMask(size_t bit_count) {
+    return bit_count >= 64 ? ~uint64_t{0} : (uint64_t{1} << bit_count) - 1;
+}
+
+// Two independent 64-bit hashes of the term ids, which come sorted, cut to bit_count bits
+Fingerprint FingerprintTerms(ForwardIndex::Range terms, size_t bit_count) {
+    Fingerprint fingerprint{ Mix(terms.size()), Mix(~uint64_t{terms.size()}) };
+    for (const TermFrequency& term : terms) {
+        fingerprint.high = Mix(fingerprint.high ^ (term.term_id + 0x9e3779b97f4a7c15ull));
+        fingerprint.low = Mix(fingerprint.low + term.term_id * 0xc2b2ae3d27d4eb4full);
+    }
+    fingerprint.high &= GetLowBitMask(bit_count > 64 ? bit_count - 64 : 0);
+    fingerprint.low &= GetLowBitMask(bit_count);
+    return fingerprint;
+}
+
+bool HaveSameTerms(ForwardIndex::Range lhs, ForwardIndex::Range rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+        [](const TermFrequency& lhs_term, const TermFrequency& rhs_term) {
+            return lhs_term.term_id == rhs_term.term_id;
+        });
+}
+
+double ComputeJaccardSimilarity(ForwardIndex::Range lhs, ForwardIndex::Range rhs) {
+    size_t common_count = 0;
+    for (auto lhs_it = lhs.begin(), rhs_it = rhs.begin(); lhs_it != lhs.end() && rhs_it != rhs.end();) {
+        if (lhs_it->term_id < rhs_it->term_id) {
+            ++lhs_it;
+        } else if (rhs_it->term_id < lhs_it->term_id) {
+            ++rhs_it;
+        } else {
+            ++common_count;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    const size_t union_count = lhs.size() + rhs.size() - common_count;
+    return union_count == 0 ? 1.0 : static_cast<double>(common_count) / union_count;
+}
+
+// Marks documents with a word set equal to that of a document with a smaller id
+void FindExactDuplicates(const SearchServer& search_server, const std::vector<int>& document_ids,
+                         const RemoveDuplicatesOptions& options,
+                         std::vector<uint8_t>& removed, std::vector<DuplicateDocument>& duplicates) {
+    const auto get_terms = [&](uint32_t document) {
+        return search_server.GetTermFrequencies(document_ids[document]);
+    };
+
+    std::vector<Fingerprint> fingerprints(document_ids.size());
+    std::vector<uint32_t> order(document_ids.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::for_each(std::execution::par, order.begin(), order.end(), [&](uint32_t document) {
+        fingerprints[document] = FingerprintTerms(get_terms(document), options.fingerprint_bits);
+    });
+    // Within a fingerprint, documents stay in id order
+    std::sort(std::execution::par, order.begin(), order.end(), [&fingerprints](uint32_t lhs, uint32_t rhs) {
+        return std::tie(fingerprints[lhs], lhs) < std::tie(fingerprints[rhs], rhs);
+    });
+
+    std::vector<uint32_t> originals;
+    for (auto group_begin = order.begin(); group_begin != order.end();) {
+        const auto group_end = std::find_if(group_begin, order.end(), [&](uint32_t document) {
+            return !(fingerprints[document] == fingerprints[*group_begin]);
+        });
+        // Different word sets that share a fingerprint each keep their first document
+        originals.clear();
+        for (auto it = group_begin; it != group_end; ++it) {
+            const auto original = std::find_if(originals.begin(), originals.end(), [&](uint32_t document) {
+                return HaveSameTerms(get_terms(document), get_terms(*it));
+            });
+            if (original == originals.end()) {
+                originals.push_back(*it);
+            } else {
+                removed[*it] = 1;
+                duplicates.push_back({ document_ids[*it], document_ids[*original], 1.0 });
+            }
+        }
+        group_begin = group_end;
+    }
+}
+
+// Disjoint sets of candidates; every set is named by its smallest member
+class CandidateClusters {
+public:
+    explicit CandidateClusters(size_t count)
+        : parents_(count)
+    {
+        std::iota(parents_.begin(), parents_.end(), 0);
+    }
+
+    uint32_t Find(uint32_t candidate) {
+        while (parents_[candidate] != candidate) {
+            parents_[candidate] = parents_[parents_[candidate]];
+            candidate = parents_[candidate];
+        }
+        return candidate;
+    }
+
+    void Unite(uint32_t lhs, uint32_t rhs) {
+        lhs = Find(lhs);
+        rhs = Find(rhs);
+        if (lhs < rhs) {
+            parents_[rhs] = lhs;
+        } else if (rhs < lhs) {
+            parents_[lhs] = rhs;
+        }
+    }
+
+private:
+    std::vector<uint32_t> parents_;
+};
+
+// Marks documents at least min_similarity similar to a kept document with a
+// smaller id. MinHash with banding (locality-sensitive hashing) groups
+// documents that agree on a whole band into clusters, joining each member of
+// a bucket to the next one only, so a large group of near copies takes linear
+// memory. Within a cluster every document is checked against the word
+// sets of the kept ones, so none is removed by chance.
+void FindNearDuplicates(const SearchServer& search_server, const std::vector<int>& document_ids,
+                        const RemoveDuplicatesOptions& options,
+                        std::vector<uint8_t>& removed, std::vector<DuplicateDocument>& duplicates) {
+    // Indexes of documents that are no exact duplicates, in id order
+    std::vector<uint32_t> candidates;
+    for (uint32_t document = 0; document < document_ids.size(); ++document) {
+        if (!removed[document]) {
+            candidates.push_back(document);
+        }
+    }
+    const auto get_terms = [&](uint32_t candidate) {
+        return search_server.GetTermFrequencies(document_ids[candidates[candidate]]);
+    };
+
+    const size_t hash_count = options.band_count * options.band_size;
+    std::vector<uint64_t> hash_seeds(hash_count);
+    for (size_t i = 0; i < hash_count; ++i) {
+        hash_seeds[i] = Mix(options.seed + i + 1);
+    }
+    std::vector<uint64_t> signatures(candidates.size() * hash_count, std::numeric_limits<uint64_t>::max());
+    std::vector<uint32_t> candidate_indexes(candidates.size());
+    std::iota(candidate_indexes.begin(), candidate_indexes.end(), 0);
+    std::for_each(std::execution::par, candidate_indexes.begin(), candidate_indexes.end(), [&](uint32_t candidate) {
+        uint64_t* signature = signatures.data() + candidate * hash_count;
+        for (const TermFrequency& term : get_terms(candidate)) {
+            for (size_t i = 0; i < hash_count; ++i) {
+                signature[i] = std::min(signature[i], Mix(term.term_id ^ hash_seeds[i]));
+            }
+        }
+    });
+
+    CandidateClusters clusters(candidates.size());
+    std::vector<std::pair<uint64_t, uint32_t>> band_keys(candidates.size());
+    for (size_t band = 0; band < options.band_count; ++band) {
+        std::for_each(std::execution::par, candidate_indexes.begin(), candidate_indexes.end(), [&](uint32_t candidate) {
+            const uint64_t* values = signatures.data() + candidate * hash_count + band * options.band_size;
+            uint64_t key = Mix(band);
+            for (size_t i = 0; i < options.band_size; ++i) {
+                key = Mix(key ^ values[i]);
+            }
+            band_keys[candidate] = { key, candidate };
+        });
+        std::sort(std::execution::par, band_keys.begin(), band_keys.end());
+        for (size_t i = 1; i < band_keys.size(); ++i) {
+            if (band_keys[i].first == band_keys[i - 1].first) {
+                clusters.Unite(band_keys[i].second, band_keys[i - 1].second);
+            }
+        }
+    }
+
+    // Clusters with more than one member, each in id order
+    std::vector<std::pair<uint32_t, uint32_t>> cluster_members(candidates.size());
+    for (uint32_t candidate = 0; candidate < candidates.size(); ++candidate) {
+        cluster_members[candidate] = { clusters.Find(candidate), candidate };
+    }
+    std::sort(std::execution::par, cluster_members.begin(), cluster_members.end());
+    std::vector<std::pair<size_t, size_t>> cluster_ranges;
+    for (size_t begin = 0; begin < cluster_members.size();) {
+        size_t end = begin + 1;
+        while (end < cluster_members.size() && cluster_members[end].first == cluster_members[begin].first) {
+            ++end;
+        }
+        if (end - begin > 1) {
+            cluster_ranges.emplace_back(begin, end);
+        }
+        begin = end;
+    }
+
+    // Clusters are independent; within one, documents are decided in id order,
+    // so whether an earlier one is still kept is settled by then
+    std::vector<std::vector<DuplicateDocument>> cluster_duplicates(cluster_ranges.size());
+    std::vector<size_t> cluster_indexes(cluster_ranges.size());
+    std::iota(cluster_indexes.begin(), cluster_indexes.end(), 0);
+    std::for_each(std::execution::par, cluster_indexes.begin(), cluster_indexes.end(), [&](size_t cluster) {
+        std::vector<uint32_t> kept;
+        for (size_t i = cluster_ranges[cluster].first; i < cluster_ranges[cluster].second; ++i) {
+            const uint32_t later = cluster_members[i].second;
+            bool found = false;
+            for (const uint32_t earlier : kept) {
+                const double similarity = ComputeJaccardSimilarity(get_terms(later), get_terms(earlier));
+                if (similarity >= options.min_similarity) {
+                    removed[candidates[later]] = 1;
+                    cluster_duplicates[cluster].push_back({ document_ids[candidates[later]], document_ids[candidates[earlier]], similarity });
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                kept.push_back(later);
+            }
+        }
+    });
+    for (const auto& found : cluster_duplicates) {
+        duplicates.insert(duplicates.end(), found.begin(), found.end());
+    }
+}
+
+} // namespace
+
+std::vector<DuplicateDocument> RemoveDuplicates(SearchServer& search_server, const RemoveDuplicatesOptions& options) {
+    if (options.min_similarity < 1.0 && (options.band_count == 0 || options.band_size == 0)) {
+        throw std::invalid_argument("Near duplicates need at least one band of at least one hash");
+    }
+
+    // In id order
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<uint8_t> removed(document_ids.size());
+    std::vector<DuplicateDocument> duplicates;
+    FindExactDuplicates(search_server, document_ids, options, removed, duplicates);
+    if (options.min_similarity < 1.0) {
+        FindNearDuplicates(search_server, document_ids, options, removed, duplicates);
+    }
+
+    std::sort(duplicates.begin(), duplicates.end(), [](const DuplicateDocument& lhs, const DuplicateDocument& rhs) {
+        return lhs.document_id < rhs.document_id;
+    });
+    // One compaction for all of them, rather than one whenever enough
+    // removals pile up in the middle
+    std::vector<int> duplicate_ids;
+    duplicate_ids.reserve(duplicates.size());
+    for (const DuplicateDocument& duplicate : duplicates) {
+        duplicate_ids.push_back(duplicate.document_id);
+    }
+    search_server.RemoveDocuments(std::execution::par, duplicate_ids);
+    return duplicates;
 }
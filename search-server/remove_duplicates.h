@@ -1,4 +1,38 @@
 #pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+struct RemoveDuplicatesOptions {
+    // Documents whose word sets have at least this Jaccard similarity to a
+    // document with a smaller id are removed too. At 1 only equal word sets count.
+    double min_similarity = 1.0;
+    // MinHash signatures for near duplicates: band_count bands of band_size
+    // hashes. Documents become candidates if all hashes of some band agree,
+    // which for similarity s happens with probability 1 - (1 - s^band_size)^band_count.
+    size_t band_count = 20;
+    size_t band_size = 5;
+    uint64_t seed = 0;
+    // Bits of the 128-bit word-set fingerprint that group exact duplicates.
+    // Fewer make different word sets share fingerprints, which only costs
+    // time; tests use it to exercise those collisions.
+    size_t fingerprint_bits = 128;
+};
+
+struct DuplicateDocument {
+    // Removed
+    int document_id;
+    // Kept document with the smallest id among those the removed one duplicates
+    int original_id;
+    // Jaccard similarity of their word sets
+    double similarity;
+};
+
+// Removes every document whose word set equals (or with min_similarity below
+// 1, is close to) the word set of a kept document with a smaller id. Documents
+// are fingerprinted in parallel; the result does not depend on the thread
+// count. The duplicates go in one RemoveDocuments call, which compacts once.
+// Returns the removed documents sorted by id.
+std::vector<DuplicateDocument> RemoveDuplicates(SearchServer& search_server, const RemoveDuplicatesOptions& options = {});
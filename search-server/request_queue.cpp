@@ -1,45 +1,30 @@
-#include <vector>
-#include <string>
-#include <map>
 #include "request_queue.h"
 
-RequestQueue::RequestQueue(const SearchServer& search_server)
+RequestQueue::RequestQueue(const SearchServer& search_server, RequestStatisticsOptions options)
     : search_server_(search_server)
-    , no_results_requests_(0)
-    , current_time_(0)
+    , statistics_(options)
     {
     
     }
 
-std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-    const auto result = search_server_.FindTopDocuments(raw_query, status);
-    AddRequest(result.size());
-    return result;
+int RequestQueue::GetNoResultRequests() const {
+    return no_results_requests_.load(std::memory_order_relaxed);
 }
 
-std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
-    const auto result = search_server_.FindTopDocuments(raw_query);
-    AddRequest(result.size());
-    return result;
+RequestWindowStats RequestQueue::GetStats(std::chrono::nanoseconds window) const {
+    return statistics_.GetStats(window);
 }
 
-int RequestQueue::GetNoResultRequests() const {
-    return no_results_requests_;
+RequestWindowStats RequestQueue::GetStats() const {
+    return statistics_.GetStats();
 }
 
-    
-    
-void RequestQueue::AddRequest(int results_num) {
-    ++current_time_;
-    while (!requests_.empty() && min_in_day_ <= current_time_ - requests_.front().timestamp) {
-        if (0 == requests_.front().results) {
-            --no_results_requests_;
-        }
-        requests_.pop_front();
-    }
-        
-    requests_.push_back({ current_time_, results_num });
-    if (0 == results_num) {
-        ++no_results_requests_;
+void RequestQueue::AddRequest(size_t results_num) {
+    // The request takes the place of the one min_in_day_ requests before it
+    const uint64_t request = current_time_.fetch_add(1, std::memory_order_relaxed);
+    const bool no_results = results_num == 0;
+    const bool replaced_no_results = no_results_[request % min_in_day_].exchange(no_results, std::memory_order_relaxed);
+    if (no_results != replaced_no_results) {
+        no_results_requests_.fetch_add(no_results ? 1 : -1, std::memory_order_relaxed);
     }
- }
\ No newline at end of file
+ }
@@ -1,38 +1,43 @@
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <utility>
 #include <vector>
-#include <string>
-#include <deque>
-#include <map>
-#include <iostream>
+#include "request_statistics.h"
 #include "search_server.h"
 
+// Runs FindTopDocuments requests and keeps statistics about them. Requests may
+// come from several threads at once.
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+    explicit RequestQueue(const SearchServer& search_server, RequestStatisticsOptions options = {});
 
-    template <typename DocumentPredicate>
-    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-        const auto documents = search_server_.FindTopDocuments(raw_query, document_predicate);
+    // Takes the arguments of any FindTopDocuments overload
+    template <typename... Args>
+    std::vector<Document> AddFindRequest(Args&&... args) {
+        auto documents = statistics_.Track([&] {
+            return search_server_.FindTopDocuments(std::forward<Args>(args)...);
+        });
         AddRequest(documents.size());
         return documents;
     }
-    
-    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
-    std::vector<Document> AddFindRequest(const std::string& raw_query);
+
+    // Among the last min_in_day_ requests
     int GetNoResultRequests() const;
-    
+
+    // Requests finished within the last `window` of wall-clock time
+    RequestWindowStats GetStats(std::chrono::nanoseconds window) const;
+    RequestWindowStats GetStats() const;
+
 private:
-    
-    struct QueryResult {
-        uint64_t timestamp;
-        int results;
-    };
-    
-    std::deque<QueryResult> requests_;
     const SearchServer& search_server_;
-    int no_results_requests_;
-    uint64_t current_time_;
+    RequestStatistics statistics_;
     const static int min_in_day_ = 1440;
+    // Whether each of the last min_in_day_ requests found nothing, by request number modulo min_in_day_
+    std::atomic<bool> no_results_[min_in_day_] = {};
+    std::atomic<uint64_t> current_time_{0};
+    std::atomic<int> no_results_requests_{0};
 
-    void AddRequest(int results_num);
-};
\ No newline at end of file
+    void AddRequest(size_t results_num);
+};
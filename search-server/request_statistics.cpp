@@ -0,0 +1,178 @@
+#include "request_statistics.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+
+namespace {
+
+std::atomic<uint64_t> next_statistics_id{1};
+
+// Tick of a slot not written yet, or being cleared for a new tick
+const int64_t NO_TICK = std::numeric_limits<int64_t>::min();
+
+} // namespace
+
+// Requests one thread finished during one slot_duration. Only the owning
+// thread writes, so plain loads and stores are enough; counts are stored with
+// release, so a reader that sees one also sees the tick cleared before it.
+struct RequestStatistics::Slot {
+    std::atomic<int64_t> tick{NO_TICK};
+    std::atomic<uint64_t> request_count{0};
+    std::atomic<uint64_t> empty_result_count{0};
+    std::atomic<uint32_t> latency_counts[LATENCY_BUCKET_COUNT];
+
+    Slot() {
+        for (auto& count : latency_counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+struct RequestStatistics::ThreadSlots {
+    std::unique_ptr<Slot[]> slots;
+    // Set when the owning thread exits
+    std::atomic<bool> abandoned{false};
+
+    explicit ThreadSlots(size_t slot_count)
+        : slots(new Slot[slot_count])
+    {
+    }
+};
+
+RequestStatistics::RequestStatistics(RequestStatisticsOptions options)
+    : options_(options)
+    , id_(next_statistics_id++)
+{
+    options_.slot_duration = std::max(options_.slot_duration, std::chrono::milliseconds(1));
+    options_.slot_count = std::max<size_t>(options_.slot_count, 1);
+}
+
+RequestStatistics::~RequestStatistics() = default;
+
+void RequestStatistics::Record(Clock::time_point finish_time, std::chrono::nanoseconds latency, size_t result_count) {
+    const auto increment = [](auto& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    };
+
+    const int64_t tick = GetTick(finish_time);
+    Slot& slot = GetThreadSlots().slots[static_cast<uint64_t>(tick) % options_.slot_count];
+    if (slot.tick.load(std::memory_order_relaxed) != tick) {
+        // The slot last held requests one whole ring ago. It has no tick while
+        // it is cleared, so GetStats never counts old requests under the new one.
+        slot.tick.store(NO_TICK, std::memory_order_relaxed);
+        slot.request_count.store(0, std::memory_order_release);
+        slot.empty_result_count.store(0, std::memory_order_release);
+        for (auto& count : slot.latency_counts) {
+            count.store(0, std::memory_order_release);
+        }
+        slot.tick.store(tick, std::memory_order_release);
+    }
+    increment(slot.request_count);
+    if (result_count == 0) {
+        increment(slot.empty_result_count);
+    }
+    increment(slot.latency_counts[LatencyHistogram::GetBucket(latency)]);
+}
+
+RequestWindowStats RequestStatistics::GetStats(std::chrono::nanoseconds window) const {
+    const int64_t slot_count = std::clamp<int64_t>(
+        (window.count() + std::chrono::nanoseconds(options_.slot_duration).count() - 1) / std::chrono::nanoseconds(options_.slot_duration).count(),
+        1, static_cast<int64_t>(options_.slot_count));
+    const int64_t last_tick = GetTick(Clock::now());
+    const int64_t first_tick = last_tick - slot_count + 1;
+
+    RequestWindowStats stats;
+    LatencyHistogram latencies;
+    std::vector<uint32_t> latency_counts(LATENCY_BUCKET_COUNT);
+    std::lock_guard guard(threads_mutex_);
+    for (const auto& thread_slots : threads_) {
+        for (size_t i = 0; i < options_.slot_count; ++i) {
+            const Slot& slot = thread_slots->slots[i];
+            const int64_t tick = slot.tick.load(std::memory_order_acquire);
+            if (tick < first_tick || tick > last_tick) {
+                continue;
+            }
+            const uint64_t request_count = slot.request_count.load(std::memory_order_acquire);
+            const uint64_t empty_result_count = slot.empty_result_count.load(std::memory_order_acquire);
+            for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+                latency_counts[bucket] = slot.latency_counts[bucket].load(std::memory_order_acquire);
+            }
+            // Skipped if the owner started clearing it for a newer tick meanwhile
+            if (slot.tick.load(std::memory_order_relaxed) != tick) {
+                continue;
+            }
+            stats.request_count += request_count;
+            stats.empty_result_count += empty_result_count;
+            for (size_t bucket = 0; bucket < LATENCY_BUCKET_COUNT; ++bucket) {
+                if (latency_counts[bucket] != 0) {
+                    latencies.AddToBucket(bucket, latency_counts[bucket]);
+                }
+            }
+        }
+    }
+    stats.p50 = latencies.GetPercentile(0.50);
+    stats.p95 = latencies.GetPercentile(0.95);
+    stats.p99 = latencies.GetPercentile(0.99);
+    stats.max = latencies.GetMax();
+    return stats;
+}
+
+RequestWindowStats RequestStatistics::GetStats() const {
+    return GetStats(options_.slot_duration * options_.slot_count);
+}
+
+int64_t RequestStatistics::GetTick(Clock::time_point time) const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(time.time_since_epoch()).count() / options_.slot_duration.count();
+}
+
+RequestStatistics::ThreadSlots& RequestStatistics::GetThreadSlots() {
+    // Most threads record into one instance, so the last one found is remembered
+    thread_local uint64_t cached_id = 0;
+    thread_local ThreadSlots* cached_slots = nullptr;
+    if (cached_id == id_) {
+        return *cached_slots;
+    }
+
+    // Slots of the thread in every instance it records into, by instance id
+    struct OwnedSlots {
+        std::vector<std::pair<uint64_t, std::shared_ptr<ThreadSlots>>> slots;
+
+        ~OwnedSlots() {
+            for (const auto& [id, thread_slots] : slots) {
+                thread_slots->abandoned.store(true, std::memory_order_release);
+            }
+        }
+    };
+    thread_local OwnedSlots owned;
+    auto found = std::find_if(owned.slots.begin(), owned.slots.end(), [this](const auto& entry) {
+        return entry.first == id_;
+    });
+    if (found == owned.slots.end()) {
+        // Slots no instance holds any more belong to instances destroyed since
+        owned.slots.erase(std::remove_if(owned.slots.begin(), owned.slots.end(), [](const auto& entry) {
+            return entry.second.use_count() == 1;
+        }), owned.slots.end());
+        auto thread_slots = std::make_shared<ThreadSlots>(options_.slot_count);
+        {
+            std::lock_guard guard(threads_mutex_);
+            // A new thread is where threads come and go, so exited ones are dropped here
+            const int64_t first_tick = GetTick(Clock::now()) - static_cast<int64_t>(options_.slot_count) + 1;
+            threads_.erase(std::remove_if(threads_.begin(), threads_.end(), [&](const auto& other) {
+                if (!other->abandoned.load(std::memory_order_acquire)) {
+                    return false;
+                }
+                for (size_t i = 0; i < options_.slot_count; ++i) {
+                    if (other->slots[i].tick.load(std::memory_order_relaxed) >= first_tick) {
+                        return false;
+                    }
+                }
+                return true;
+            }), threads_.end());
+            threads_.push_back(thread_slots);
+        }
+        found = owned.slots.insert(owned.slots.end(), { id_, std::move(thread_slots) });
+    }
+    cached_id = id_;
+    cached_slots = found->second.get();
+    return *cached_slots;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "latency_histogram.h"
+
+struct RequestStatisticsOptions {
+    // Requests are counted in slots of this much time
+    std::chrono::milliseconds slot_duration{1000};
+    // Slots kept; the longest window is slot_count * slot_duration
+    size_t slot_count = 60;
+};
+
+// Requests of one time window
+struct RequestWindowStats {
+    uint64_t request_count = 0;
+    // Requests that found no documents
+    uint64_t empty_result_count = 0;
+    std::chrono::nanoseconds p50{0};
+    std::chrono::nanoseconds p95{0};
+    std::chrono::nanoseconds p99{0};
+    std::chrono::nanoseconds max{0};
+};
+
+// Request counts and latencies over a sliding window of wall-clock time.
+//
+// Every thread records into its own ring of time slots, so recording takes no
+// lock and shares no cache line with other threads. GetStats merges the slots
+// of all threads that fall into the window; while requests are being
+// recorded the result may miss the latest of them. The slots of a thread that
+// has exited are dropped once they are older than every window.
+class RequestStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit RequestStatistics(RequestStatisticsOptions options = {});
+    ~RequestStatistics();
+
+    RequestStatistics(const RequestStatistics&) = delete;
+    RequestStatistics& operator=(const RequestStatistics&) = delete;
+
+    // Runs search(), which returns the found documents, and records how long it took
+    template <typename Search>
+    auto Track(Search search);
+
+    void Record(Clock::time_point finish_time, std::chrono::nanoseconds latency, size_t result_count);
+
+    // Requests finished within `window` before now, rounded up to whole slots
+    // and limited to the slots kept
+    RequestWindowStats GetStats(std::chrono::nanoseconds window) const;
+    // Over every slot kept
+    RequestWindowStats GetStats() const;
+
+private:
+    struct Slot;
+    struct ThreadSlots;
+
+    RequestStatisticsOptions options_;
+    // Tells apart instances that reuse an address, for the per-thread lookup
+    uint64_t id_;
+    mutable std::mutex threads_mutex_;
+    // Shared with the thread recording into them, which may outlive the instance
+    std::vector<std::shared_ptr<ThreadSlots>> threads_;
+
+    int64_t GetTick(Clock::time_point time) const;
+    ThreadSlots& GetThreadSlots();
+};
+
+template <typename Search>
+auto RequestStatistics::Track(Search search) {
+    const auto start_time = Clock::now();
+    auto documents = search();
+    const auto finish_time = Clock::now();
+    Record(finish_time, finish_time - start_time, documents.size());
+    return documents;
+}
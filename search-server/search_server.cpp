@@ -2,9 +2,12 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <deque>
+#include <map>
 #include <tuple>
 #include <cmath>
 #include <numeric>
+#include <unordered_map>
 #include "document.h"
 #include "string_processing.h"
 
@@ -15,18 +18,200 @@ SearchServer::SearchServer(const std::string& stop_words_text)
 }
 
 void SearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
-    if ((document_id < 0) || (documents_.count(document_id) > 0)) {
+    PROFILE_STAGE(ProfileStage::ADD_DOCUMENT);
+    if ((document_id < 0) || (document_ordinals_.count(document_id) > 0)) {
         throw std::invalid_argument("Invalid document_id");
     }
     const auto words = SplitIntoWordsNoStop(document);
+    const uint32_t ordinal = static_cast<uint32_t>(documents_.size());
     
     const double inv_word_count = 1.0 / words.size();
+    std::map<std::string_view, uint32_t> word_counts;
     for (const std::string_view word : words) {
-        word_to_document_freqs_[std::string{word}][document_id] += inv_word_count;
-        word_freqs_[document_id][word] += inv_word_count;
+        ++word_counts[word];
     }
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
+    std::vector<TermFrequency> term_freqs;
+    term_freqs.reserve(word_counts.size());
+    for (const auto [word, count] : word_counts) {
+        const double term_freq = count * inv_word_count;
+        const TermId term_id = InsertTerm(word);
+        term_freqs.push_back({ term_id, term_freq });
+        write_segment_.Add(term_id, ordinal, count, term_freq);
+        ++term_document_counts_[term_id];
+    }
+    document_ordinals_.emplace(document_id, ordinal);
     document_ids_.insert(document_id);
+    AppendDocumentData(document_id, document, status, ratings, inv_word_count, term_freqs);
+    MaintainSegments();
+    ++epoch_;
+}
+
+struct SearchServer::PartialIndex {
+    struct Posting {
+        // Position of the document in the slice
+        uint32_t document;
+        uint32_t count;
+    };
+    struct Term {
+        std::string_view word;
+        std::vector<Posting> postings;
+    };
+
+    // In order of first occurrence
+    std::vector<Term> terms;
+    // Per document of the slice
+    std::vector<size_t> word_counts;
+    // Per document of the slice; empty if the text was tokenized
+    std::vector<std::string> errors;
+};
+
+std::vector<RejectedDocument> SearchServer::AddDocuments(const std::vector<DocumentToAdd>& documents) {
+    return AddDocuments(std::execution::seq, documents);
+}
+
+std::vector<RejectedDocument> SearchServer::AddDocuments(const std::execution::parallel_policy& policy, const std::vector<DocumentToAdd>& documents) {
+    return AddDocumentBatch(policy, documents);
+}
+
+std::vector<RejectedDocument> SearchServer::AddDocuments(const std::execution::sequenced_policy& policy, const std::vector<DocumentToAdd>& documents) {
+    return AddDocumentBatch(policy, documents);
+}
+
+template <typename ExecutionPolicy>
+std::vector<RejectedDocument> SearchServer::AddDocumentBatch(ExecutionPolicy&& policy, const std::vector<DocumentToAdd>& documents) {
+    PROFILE_STAGE(ProfileStage::ADD_DOCUMENTS);
+    const size_t max_chunk_count = std::max(1u, std::thread::hardware_concurrency()) * 4;
+    const size_t chunk_count = std::clamp<size_t>(documents.size() / MIN_INGEST_CHUNK_SIZE, 1, max_chunk_count);
+    const auto chunk_begin = [&documents, chunk_count](size_t chunk) {
+        return documents.size() * chunk / chunk_count;
+    };
+
+    // Tokenizing does not touch the server, so slices are indexed independently;
+    // only the merge, which hands out term ids and ordinals, runs in batch order
+    std::vector<PartialIndex> partial_indexes(chunk_count);
+    std::vector<size_t> chunk_indexes(chunk_count);
+    std::iota(chunk_indexes.begin(), chunk_indexes.end(), 0);
+    std::for_each(policy, chunk_indexes.begin(), chunk_indexes.end(), [&](size_t chunk) {
+        partial_indexes[chunk] = BuildPartialIndex(documents.data() + chunk_begin(chunk), documents.data() + chunk_begin(chunk + 1));
+    });
+
+    std::vector<RejectedDocument> rejected;
+    for (size_t chunk = 0; chunk < chunk_count; ++chunk) {
+        // A slice always lands in a single write segment
+        MergePartialIndex(partial_indexes[chunk], documents, chunk_begin(chunk), rejected);
+        partial_indexes[chunk] = PartialIndex();
+        MaintainSegments();
+    }
+    ++epoch_;
+    return rejected;
+}
+
+SearchServer::PartialIndex SearchServer::BuildPartialIndex(const DocumentToAdd* first, const DocumentToAdd* last) const {
+    PartialIndex partial_index;
+    partial_index.word_counts.reserve(last - first);
+    partial_index.errors.resize(last - first);
+    std::unordered_map<std::string_view, uint32_t> term_indexes;
+    std::vector<uint32_t> document_terms;
+    for (uint32_t document = 0; first + document != last; ++document) {
+        std::vector<std::string_view> words;
+        try {
+            words = SplitIntoWordsNoStop(first[document].text);
+        } catch (const std::invalid_argument& e) {
+            partial_index.errors[document] = e.what();
+        }
+        partial_index.word_counts.push_back(words.size());
+
+        document_terms.clear();
+        for (const std::string_view word : words) {
+            const auto [it, inserted] = term_indexes.emplace(word, static_cast<uint32_t>(partial_index.terms.size()));
+            if (inserted) {
+                partial_index.terms.push_back({ word, {} });
+            }
+            document_terms.push_back(it->second);
+        }
+        std::sort(document_terms.begin(), document_terms.end());
+        for (size_t i = 0; i < document_terms.size();) {
+            size_t j = i + 1;
+            while (j < document_terms.size() && document_terms[j] == document_terms[i]) {
+                ++j;
+            }
+            partial_index.terms[document_terms[i]].postings.push_back({ document, static_cast<uint32_t>(j - i) });
+            i = j;
+        }
+    }
+    return partial_index;
+}
+
+void SearchServer::MergePartialIndex(const PartialIndex& partial_index, const std::vector<DocumentToAdd>& documents,
+                                     size_t first_index, std::vector<RejectedDocument>& rejected) {
+    constexpr uint32_t NOT_ADDED = std::numeric_limits<uint32_t>::max();
+    const size_t document_count = partial_index.word_counts.size();
+
+    // Checked in batch order, so a duplicate id is caught exactly as AddDocument would
+    std::vector<uint32_t> ordinals(document_count, NOT_ADDED);
+    uint32_t next_ordinal = static_cast<uint32_t>(documents_.size());
+    for (size_t document = 0; document < document_count; ++document) {
+        const int document_id = documents[first_index + document].id;
+        if ((document_id < 0) || (document_ordinals_.count(document_id) > 0)) {
+            rejected.push_back({ first_index + document, document_id, "Invalid document_id" });
+        } else if (!partial_index.errors[document].empty()) {
+            rejected.push_back({ first_index + document, document_id, partial_index.errors[document] });
+        } else {
+            ordinals[document] = next_ordinal++;
+            document_ordinals_.emplace(document_id, ordinals[document]);
+            document_ids_.insert(document_id);
+        }
+    }
+
+    std::vector<std::vector<TermFrequency>> term_freqs(document_count);
+    for (const PartialIndex::Term& term : partial_index.terms) {
+        TermId term_id = TermDictionary::NO_TERM;
+        for (const PartialIndex::Posting& posting : term.postings) {
+            const uint32_t ordinal = ordinals[posting.document];
+            if (ordinal == NOT_ADDED) {
+                continue;
+            }
+            if (term_id == TermDictionary::NO_TERM) {
+                term_id = InsertTerm(term.word);
+            }
+            const double term_freq = posting.count * (1.0 / partial_index.word_counts[posting.document]);
+            write_segment_.Add(term_id, ordinal, posting.count, term_freq);
+            ++term_document_counts_[term_id];
+            term_freqs[posting.document].push_back({ term_id, term_freq });
+        }
+    }
+
+    for (size_t document = 0; document < document_count; ++document) {
+        if (ordinals[document] == NOT_ADDED) {
+            continue;
+        }
+        const DocumentToAdd& input = documents[first_index + document];
+        AppendDocumentData(input.id, input.text, input.status, input.ratings,
+                           1.0 / partial_index.word_counts[document], term_freqs[document]);
+    }
+}
+
+SearchServer::TermId SearchServer::InsertTerm(std::string_view word) {
+    const TermId term_id = terms_.Insert(word);
+    if (term_id == term_document_counts_.size()) {
+        term_document_counts_.push_back(0);
+    }
+    return term_id;
+}
+
+void SearchServer::AppendDocumentData(int document_id, std::string_view document, DocumentStatus status,
+                                      const std::vector<int>& ratings, double inv_word_count,
+                                      std::vector<TermFrequency>& term_freqs) {
+    const uint32_t ordinal = static_cast<uint32_t>(documents_.size());
+    std::sort(term_freqs.begin(), term_freqs.end(), [](const TermFrequency& lhs, const TermFrequency& rhs) {
+        return lhs.term_id < rhs.term_id;
+    });
+    forward_index_.Add(term_freqs);
+    const std::string_view text = document_texts_.Store(document);
+    documents_.push_back(DocumentData{ document_id, ComputeAverageRating(ratings), status, inv_word_count, text });
+    documents_by_status_[status].Add(ordinal);
+    live_documents_.Add(ordinal);
+    write_segment_.Extend(ordinal + 1);
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
@@ -37,88 +222,316 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query)
     return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries, DocumentStatus status) const {
+    std::vector<std::vector<Document>> results;
+    results.reserve(raw_queries.size());
+    // MaxScore prunes against each query's own top, which a shared traversal cannot do
+    if (retrieval_mode_ == RetrievalMode::MAX_SCORE) {
+        for (const std::string_view raw_query : raw_queries) {
+            results.push_back(FindTopDocuments(raw_query, status));
+        }
+        return results;
+    }
+
+    std::vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    for (const std::string_view raw_query : raw_queries) {
+        queries.push_back(ParseQuery(raw_query));
+    }
+    for (size_t first = 0; first < queries.size(); first += MAX_BATCH_QUERY_COUNT) {
+        FindTopDocumentsBatchPart(queries.data() + first, std::min(MAX_BATCH_QUERY_COUNT, queries.size() - first), status, results);
+    }
+    return results;
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries) const {
+    return FindTopDocumentsBatch(raw_queries, DocumentStatus::ACTUAL);
+}
+
+void SearchServer::FindTopDocumentsBatchPart(const Query* queries, size_t query_count, DocumentStatus status,
+                                             std::vector<std::vector<Document>>& results) const {
+    // A deque never moves its elements, which CandidateFilter does not allow
+    std::deque<CandidateFilter> filters;
+    std::vector<const CandidateFilter*> query_filters(query_count);
+    const DocumentBitmap& allowed = GetDocumentsWithStatus(status);
+    // Queries of each plus word. Words are visited in sorted order, like the
+    // plus words of one query, so every score is summed in the same order as
+    // FindTopDocuments sums it and comes out exactly the same.
+    struct WordQueries {
+        // Queries without minus words share one filter, tested once per posting
+        std::vector<uint32_t> unfiltered;
+        std::vector<uint32_t> filtered;
+    };
+    std::map<std::string_view, WordQueries> word_queries;
+    for (size_t query = 0; query < query_count; ++query) {
+        PROFILE_STAGE(ProfileStage::FILTERING);
+        DocumentBitmap excluded = CollectMinusWordDocuments(queries[query]);
+        const bool unfiltered = excluded.empty();
+        query_filters[query] = &filters.emplace_back(&allowed, std::move(excluded));
+        if (query_filters[query]->IsEmpty()) {
+            continue;
+        }
+        for (const std::string_view word : queries[query].plus_words) {
+            WordQueries& queries_of_word = word_queries[word];
+            (unfiltered ? queries_of_word.unfiltered : queries_of_word.filtered).push_back(static_cast<uint32_t>(query));
+        }
+    }
+
+    struct BatchTerm {
+        TermId term_id;
+        double inverse_document_freq;
+        const WordQueries* queries;
+    };
+    std::vector<BatchTerm> terms;
+    {
+        PROFILE_STAGE(ProfileStage::POSTING_LOOKUP);
+        for (const auto& [word, queries_of_word] : word_queries) {
+            const TermId term_id = FindLiveTerm(word);
+            if (term_id != TermDictionary::NO_TERM) {
+                terms.push_back({ term_id, ComputeWordInverseDocumentFreq(term_id), &queries_of_word });
+            }
+        }
+    }
+
+    // Ordinals are scored a window at a time, so the scores of all queries fit
+    // in BATCH_SCORE_SLOT_COUNT slots, which MAX_BATCH_QUERY_COUNT guarantees
+    // even with the window at its smallest; a window's scores are final once
+    // every term has passed it
+    const uint32_t window_size = static_cast<uint32_t>(std::max<size_t>(MIN_BATCH_WINDOW_SIZE, BATCH_SCORE_SLOT_COUNT / query_count));
+    std::vector<RelevanceAccumulator> window_scores(query_count);
+    for (RelevanceAccumulator& scores : window_scores) {
+        scores.Reset(window_size);
+    }
+    std::vector<TopDocuments> top_documents(query_count, TopDocuments(max_result_document_count_));
+
+    struct SegmentTerm {
+        PostingList::Cursor postings;
+        const BatchTerm* term;
+    };
+    const uint32_t ordinal_count = static_cast<uint32_t>(documents_.size());
+    ForEachSegment(0, ordinal_count, [&](const IndexSegment& segment) {
+        std::vector<SegmentTerm> cursors;
+        {
+            PROFILE_STAGE(ProfileStage::POSTING_LOOKUP);
+            for (const BatchTerm& term : terms) {
+                const PostingList::View postings = segment.Find(term.term_id);
+                if (!postings.empty()) {
+                    cursors.push_back({ PostingList::Cursor(postings), &term });
+                }
+            }
+        }
+        if (cursors.empty()) {
+            return;
+        }
+        const uint32_t last_ordinal = std::min(segment.GetEndOrdinal(), ordinal_count);
+        for (uint32_t window_begin = segment.GetFirstOrdinal(); window_begin < last_ordinal; ) {
+            const uint32_t window_end = window_begin + std::min(window_size, last_ordinal - window_begin);
+            {
+                PROFILE_STAGE(ProfileStage::SCORING);
+                for (SegmentTerm& cursor : cursors) {
+                    const double inverse_document_freq = cursor.term->inverse_document_freq;
+                    for (PostingList::Cursor& postings = cursor.postings; !postings.AtEnd() && postings.GetOrdinal() < window_end; postings.Next()) {
+                        const uint32_t ordinal = postings.GetOrdinal();
+                        const double relevance = postings.GetCount() * documents_[ordinal].inv_word_count * inverse_document_freq;
+                        if (allowed.Contains(ordinal)) {
+                            for (const uint32_t query : cursor.term->queries->unfiltered) {
+                                window_scores[query].Add(ordinal - window_begin, relevance);
+                            }
+                        }
+                        for (const uint32_t query : cursor.term->queries->filtered) {
+                            if (query_filters[query]->Accepts(ordinal)) {
+                                window_scores[query].Add(ordinal - window_begin, relevance);
+                            }
+                        }
+                    }
+                }
+            }
+            {
+                PROFILE_STAGE(ProfileStage::TOP_K);
+                for (size_t query = 0; query < query_count; ++query) {
+                    RelevanceAccumulator& scores = window_scores[query];
+                    if (scores.touched().empty()) {
+                        continue;
+                    }
+                    for (const uint32_t offset : scores.touched()) {
+                        const DocumentData& document_data = documents_[window_begin + offset];
+                        top_documents[query].Add({ document_data.id, scores.GetScore(offset), document_data.rating });
+                    }
+                    scores.Reset(window_size);
+                }
+            }
+            window_begin = window_end;
+        }
+    });
+
+    PROFILE_STAGE(ProfileStage::RESULT_BUILD);
+    for (TopDocuments& query_top : top_documents) {
+        results.push_back(query_top.Extract());
+    }
+}
+
 int SearchServer::GetDocumentCount() const {
-    return documents_.size();
+    return document_ordinals_.size();
+}
+
+bool SearchServer::HasDocument(int document_id) const {
+    return document_ordinals_.count(document_id) > 0;
+}
+
+void SearchServer::CheckDocumentText(std::string_view document) {
+    // Spaces are valid, so the text is valid when all its words are
+    if (!IsValidWord(document)) {
+        throw std::invalid_argument("наличие недопустимых символов");
+    }
+}
+
+int SearchServer::GetDocumentFreq(std::string_view word) const {
+    const TermId term_id = terms_.Find(word);
+    return term_id == TermDictionary::NO_TERM ? 0 : term_document_counts_[term_id];
+}
+
+void SearchServer::SetCorpusStatistics(const CorpusStatistics* statistics) {
+    // The new statistics may have any version, so epoch_ first moves past every
+    // result epoch so far; otherwise old results could come back as current
+    epoch_ = GetResultEpoch() + 1;
+    corpus_statistics_ = statistics;
+}
+
+void SearchServer::SetMaxResultDocumentCount(size_t count) {
+    max_result_document_count_ = count;
+}
+
+size_t SearchServer::GetMaxResultDocumentCount() const {
+    return max_result_document_count_;
+}
+
+void SearchServer::SetRetrievalMode(RetrievalMode mode) {
+    retrieval_mode_ = mode;
+    // MaxScore sums relevances in another order, which may change their last bits
+    ++epoch_;
+}
+
+RetrievalMode SearchServer::GetRetrievalMode() const {
+    return retrieval_mode_;
+}
+
+void SearchServer::EnableResultCache(QueryResultCacheOptions options) {
+    result_cache_ = std::make_unique<QueryResultCache>(options);
+}
+
+void SearchServer::DisableResultCache() {
+    result_cache_.reset();
+}
+
+QueryResultCacheStats SearchServer::GetResultCacheStats() const {
+    return result_cache_ != nullptr ? result_cache_->GetStats() : QueryResultCacheStats();
+}
+
+uint64_t SearchServer::GetEpoch() const {
+    return epoch_;
 }
 
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
     const Query query = ParseQuery(raw_query);
+    const uint32_t ordinal = document_ordinals_.at(document_id);
+    const DocumentStatus status = documents_[ordinal].status;
 
     std::vector<std::string_view> matched_words;
     for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(std::string(word)) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(std::string(word)).count(document_id)) {
-            matched_words.clear();
-            return { {}, documents_.at(document_id).status };
+        const TermId term_id = terms_.Find(word);
+        if (term_id != TermDictionary::NO_TERM && forward_index_.Find(ordinal, term_id) != nullptr) {
+            return { std::vector<std::string_view>{}, status };
         }
     }
     for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(std::string(word)) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(std::string(word)).count(document_id)) {
-            matched_words.push_back(word);
+        const TermId term_id = terms_.Find(word);
+        if (term_id != TermDictionary::NO_TERM && forward_index_.Find(ordinal, term_id) != nullptr) {
+            matched_words.push_back(terms_.GetTerm(term_id));
         }
     }
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, status };
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy& policy, std::string_view raw_query, int document_id) const {
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query, int document_id) const {
     return MatchDocument(raw_query, document_id);
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::execution::parallel_policy& policy, std::string_view raw_query, int document_id) const {
-    if ((document_id < 0) || (documents_.count(document_id) == 0)) {
+    if ((document_id < 0) || (document_ordinals_.count(document_id) == 0)) {
             throw std::invalid_argument("document_id out of range");
         }
 
     const Query& query = ParseQueryParallel(raw_query);
-    const auto& word_freqs = word_freqs_.at(document_id);
+    const uint32_t ordinal = document_ordinals_.at(document_id);
+    const DocumentStatus status = documents_[ordinal].status;
+    const auto contains = [this, ordinal](TermId term_id) {
+        return term_id != TermDictionary::NO_TERM && forward_index_.Find(ordinal, term_id) != nullptr;
+    };
     
     if (std::any_of(query.minus_words.begin(),
                     query.minus_words.end(),
-                    [&word_freqs](const std::string_view word) {
-                        return word_freqs.count(word) > 0;
+                    [this, &contains](const std::string_view word) {
+                        return contains(terms_.Find(word));
                     })) {
-        return { {}, documents_.at(document_id).status };
+        return { std::vector<std::string_view>{}, status };
     }
 
     std::vector<std::string_view> matched_words;
     matched_words.reserve(query.plus_words.size());
-    std::copy_if(query.plus_words.begin(),
-                 query.plus_words.end(),
-                 std::back_inserter(matched_words),
-                 [&word_freqs](const std::string_view word) {
-                     return word_freqs.count(word) > 0;
-                 });
+    for (const std::string_view word : query.plus_words) {
+        const TermId term_id = terms_.Find(word);
+        if (contains(term_id)) {
+            matched_words.push_back(terms_.GetTerm(term_id));
+        }
+    }
 
     std::sort(policy, matched_words.begin(), matched_words.end());
     auto it = std::unique(matched_words.begin(), matched_words.end());
     matched_words.erase(it, matched_words.end());
 
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, status };
     
 }
 
 
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const std::map<std::string_view, double> dummy;
-    if (word_freqs_.count(document_id) == 0) {
-        return dummy;
+ForwardIndex::Range SearchServer::GetTermFrequencies(int document_id) const {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+        return ForwardIndex::Range(nullptr, nullptr);
     }
-    else {
-        return word_freqs_.at(document_id);
+    return forward_index_.Get(it->second);
+}
+
+std::string_view SearchServer::GetTerm(uint32_t term_id) const {
+    return terms_.GetTerm(term_id);
+}
+
+std::map<std::string_view, double> SearchServer::GetWordFrequencies(int document_id) const {
+    std::map<std::string_view, double> word_freqs;
+    for (const auto [term_id, term_freq] : GetTermFrequencies(document_id)) {
+        word_freqs.emplace(terms_.GetTerm(term_id), term_freq);
+    }
+    return word_freqs;
+}
+
+
+std::string_view SearchServer::GetDocumentText(int document_id) const {
+    const auto it = document_ordinals_.find(document_id);
+    if (it == document_ordinals_.end()) {
+        return {};
     }
+    return documents_[it->second].text;
 }
 
+size_t SearchServer::GetTextMemoryUsage() const {
+    return document_texts_.GetAllocatedBytes() + terms_.GetArena().GetAllocatedBytes();
+}
 
 bool SearchServer::IsStopWord(std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_word_set_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(std::string_view word) {
@@ -130,13 +543,8 @@ bool SearchServer::IsValidWord(std::string_view word) {
 
 std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
     std::vector<std::string_view> words;
-    for (const auto& word : SplitIntoWordsView(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("наличие недопустимых символов");
-        }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
-        }
+    if (!SplitIntoValidWords(text, &stop_word_set_, words)) {
+        throw std::invalid_argument("наличие недопустимых символов");
     }
     return words;
 }
@@ -160,19 +568,34 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view  text) con
         is_minus = true; 
         text = text.substr(1); 
     } 
-    if (text.empty() || text[0] == '-' || !IsValidWord(text)) { 
+    if (text.empty() || text[0] == '-') { 
         throw std::invalid_argument("Query word " + std::string(text) + " is invalid"); 
     } 
  
     return {text, is_minus, IsStopWord(text)};
 }
 
+std::vector<std::string_view> SearchServer::SplitQueryWords(std::string_view text) const {
+    std::vector<std::string_view> words;
+    if (!SplitIntoValidWords(text, nullptr, words)) {
+        // Checked word by word again so the error names the same word as before
+        for (const std::string_view word : SplitIntoWordsView(text)) {
+            const QueryWord query_word = ParseQueryWord(word);
+            if (!IsValidWord(query_word.data)) {
+                throw std::invalid_argument("Query word " + std::string(query_word.data) + " is invalid");
+            }
+        }
+    }
+    return words;
+}
+
 
 
 SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
+    PROFILE_STAGE(ProfileStage::PARSE_QUERY);
     Query result;
 
-    for (const std::string_view word : SplitIntoWordsView(text)) {
+    for (const std::string_view word : SplitQueryWords(text)) {
         const QueryWord query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
@@ -196,9 +619,10 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view text) const {
 }
 
 SearchServer::Query SearchServer::ParseQueryParallel(std::string_view text) const {
+    PROFILE_STAGE(ProfileStage::PARSE_QUERY);
     Query result;
 
-    for (auto word : SplitIntoWordsView(text)) {
+    for (auto word : SplitQueryWords(text)) {
         const QueryWord query_word(ParseQueryWord(word));
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
@@ -212,43 +636,479 @@ SearchServer::Query SearchServer::ParseQueryParallel(std::string_view text) cons
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(std::string(word)).size());
+SearchServer::TermId SearchServer::FindLiveTerm(std::string_view word) const {
+    const TermId term_id = terms_.Find(word);
+    if (term_id == TermDictionary::NO_TERM || term_document_counts_[term_id] == 0) {
+        return TermDictionary::NO_TERM;
+    }
+    return term_id;
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term_id) const {
+    if (corpus_statistics_ != nullptr) {
+        return log(corpus_statistics_->GetDocumentCount() * 1.0 / corpus_statistics_->GetDocumentFreq(terms_.GetTerm(term_id)));
+    }
+    return log(GetDocumentCount() * 1.0 / term_document_counts_[term_id]);
+}
+
+std::string SearchServer::MakeResultCacheKey(const Query& query, DocumentStatus status) const {
+    const auto append_value = [](std::string& key, auto value) {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    // Words are sorted and unique, and each is prefixed by its size, so equal
+    // keys mean equal queries
+    std::string key;
+    append_value(key, static_cast<uint64_t>(max_result_document_count_));
+    append_value(key, static_cast<int32_t>(status));
+    for (const auto* words : { &query.plus_words, &query.minus_words }) {
+        append_value(key, static_cast<uint32_t>(words->size()));
+        for (const std::string_view word : *words) {
+            append_value(key, static_cast<uint32_t>(word.size()));
+            key.append(word);
+        }
+    }
+    return key;
+}
+
+uint64_t SearchServer::GetResultEpoch() const {
+    return corpus_statistics_ != nullptr ? epoch_ + corpus_statistics_->GetVersion() : epoch_;
+}
+
+RelevanceAccumulator& SearchServer::GetThreadAccumulator(size_t document_count) {
+    thread_local RelevanceAccumulator relevance_doc;
+    relevance_doc.Reset(document_count);
+    return relevance_doc;
+}
+
+SearchServer::CandidateFilter::CandidateFilter(const DocumentBitmap* allowed, DocumentBitmap excluded)
+    : allowed_(allowed)
+    , excluded_(std::move(excluded))
+{
+    if (!excluded_.empty()) {
+        allowed_storage_ = *allowed_;
+        allowed_storage_.AndNot(excluded_);
+        allowed_ = &allowed_storage_;
+    }
+}
+
+DocumentBitmap SearchServer::CollectMinusWordDocuments(const Query& query) const {
+    DocumentBitmap excluded;
+    for (auto word : query.minus_words) {
+        const TermId term_id = FindLiveTerm(word);
+        if (term_id == TermDictionary::NO_TERM) {
+            continue;
+        }
+        ForEachSegment(0, static_cast<uint32_t>(documents_.size()), [&excluded, term_id](const IndexSegment& segment) {
+            const PostingList::View postings = segment.Find(term_id);
+            if (postings.empty()) {
+                return;
+            }
+            for (PostingList::Cursor cursor(postings); !cursor.AtEnd(); cursor.Next()) {
+                excluded.Add(cursor.GetOrdinal());
+            }
+        });
+    }
+    return excluded;
+}
+
+SearchServer::CandidateFilter SearchServer::MakeCandidateFilter(const Query& query, const DocumentBitmap* allowed) const {
+    PROFILE_STAGE(ProfileStage::FILTERING);
+    return CandidateFilter(allowed, CollectMinusWordDocuments(query));
+}
+
+const DocumentBitmap& SearchServer::GetDocumentsWithStatus(DocumentStatus status) const {
+    static const DocumentBitmap empty;
+    const auto it = documents_by_status_.find(status);
+    return it == documents_by_status_.end() ? empty : it->second;
+}
+
+std::vector<SearchServer::TermCursor> SearchServer::MakeTermCursors(const Query& query, const IndexSegment& segment,
+                                                                    uint32_t first_ordinal, uint32_t last_ordinal) const {
+    PROFILE_STAGE(ProfileStage::POSTING_LOOKUP);
+    std::vector<TermCursor> cursors;
+    cursors.reserve(query.plus_words.size());
+    for (auto word : query.plus_words) {
+        const TermId term_id = FindLiveTerm(word);
+        if (term_id == TermDictionary::NO_TERM) {
+            continue;
+        }
+        const PostingList::View postings = segment.Find(term_id);
+        if (postings.empty()) {
+            continue;
+        }
+        // Global IDF, so scores do not depend on how documents are split into segments
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+        cursors.push_back({ PostingList::Cursor(postings, first_ordinal, last_ordinal),
+                            inverse_document_freq, postings.max_term_freq * inverse_document_freq });
+    }
+    std::sort(cursors.begin(), cursors.end(), [](const TermCursor& lhs, const TermCursor& rhs) {
+        return lhs.max_relevance < rhs.max_relevance;
+    });
+    return cursors;
+}
+
+std::vector<Document> SearchServer::SelectTopDocuments(const RelevanceAccumulator& relevance_doc) const {
+    TopDocuments top_documents(max_result_document_count_);
+    {
+        PROFILE_STAGE(ProfileStage::TOP_K);
+        for (const uint32_t ordinal : relevance_doc.touched()) {
+            const DocumentData& document_data = documents_[ordinal];
+            top_documents.Add({ document_data.id, relevance_doc.GetScore(ordinal), document_data.rating });
+        }
+    }
+    PROFILE_STAGE(ProfileStage::RESULT_BUILD);
+    return top_documents.Extract();
 }
 
 void SearchServer::RemoveDocument(int document_id){
-    documents_.erase(document_id);
-    word_freqs_.erase(document_id);
-    document_ids_.erase(document_id);
-    for(auto &[word, documents] : word_to_document_freqs_){
-        documents.erase(document_id);
+    if (MarkRemoved(document_id) && NeedsCompaction()) {
+        Compact();
+    }
+}
+
+void SearchServer::RemoveDocument(const std::execution::parallel_policy& policy, int document_id){
+    if (!MarkRemoved(document_id)) {
+        throw std::out_of_range("Unknown document_id");
+    }
+    if (NeedsCompaction()) {
+        Compact(policy);
+    }
+}
+
+void SearchServer::RemoveDocument(const std::execution::sequenced_policy& policy, int document_id){
+    if (!MarkRemoved(document_id)) {
+        throw std::out_of_range("Unknown document_id");
+    }
+    if (NeedsCompaction()) {
+        Compact(policy);
+    }
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    RemoveDocuments(std::execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(const std::execution::parallel_policy& policy, const std::vector<int>& document_ids) {
+    for (const int document_id : document_ids) {
+        MarkRemoved(document_id);
+    }
+    Compact(policy);
+}
+
+void SearchServer::RemoveDocuments(const std::execution::sequenced_policy& policy, const std::vector<int>& document_ids) {
+    for (const int document_id : document_ids) {
+        MarkRemoved(document_id);
     }
+    Compact(policy);
 }
 
-void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id){
-    documents_.erase(document_id);
+void SearchServer::Compact() {
+    Compact(std::execution::seq);
+}
+
+void SearchServer::Compact(const std::execution::parallel_policy& policy) {
+    PurgeRemovedDocuments(policy);
+}
+
+void SearchServer::Compact(const std::execution::sequenced_policy& policy) {
+    PurgeRemovedDocuments(policy);
+}
+
+size_t SearchServer::GetPendingRemovalCount() const {
+    return pending_removals_.size();
+}
+
+bool SearchServer::MarkRemoved(int document_id) {
+    PROFILE_STAGE(ProfileStage::REMOVE_DOCUMENT);
+    const auto ordinal_it = document_ordinals_.find(document_id);
+    if (ordinal_it == document_ordinals_.end()) {
+        return false;
+    }
+    const uint32_t ordinal = ordinal_it->second;
+    document_ordinals_.erase(ordinal_it);
     document_ids_.erase(document_id);
-    const auto& word_freqs = word_freqs_.at(document_id);
-    std::vector<std::string> words(word_freqs.size());
-    transform(std::execution::par, word_freqs.begin(), word_freqs.end(), words.begin(), [](const auto& word) {
-        return word.first;
+    documents_by_status_[documents_[ordinal].status].Remove(ordinal);
+    live_documents_.Remove(ordinal);
+    // Document frequencies stay exact, so IDF does not depend on when compaction runs
+    for (const TermFrequency& entry : forward_index_.Get(ordinal)) {
+        --term_document_counts_[entry.term_id];
+    }
+    removed_documents_.Add(ordinal);
+    pending_removals_.push_back(ordinal);
+    ++epoch_;
+    return true;
+}
+
+bool SearchServer::NeedsCompaction() const {
+    return pending_removals_.size() >= MIN_COMPACTION_REMOVALS
+        && pending_removals_.size() * 4 >= document_ordinals_.size();
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::PurgeRemovedDocuments(ExecutionPolicy&& policy) {
+    if (pending_removals_.empty()) {
+        return;
+    }
+    PROFILE_STAGE(ProfileStage::COMPACTION);
+    if (pending_merge_) {
+        FinishMerge();
+    }
+
+    // The write segment is purged in place, each posting list once however
+    // many removed documents it holds
+    const uint32_t write_segment_begin = write_segment_.GetFirstOrdinal();
+    std::vector<TermId> term_ids;
+    std::vector<size_t> segment_indexes;
+    for (const uint32_t ordinal : pending_removals_) {
+        if (ordinal >= write_segment_begin) {
+            for (const TermFrequency& entry : forward_index_.Get(ordinal)) {
+                term_ids.push_back(entry.term_id);
+            }
+        } else {
+            const auto it = std::upper_bound(sealed_segments_.begin(), sealed_segments_.end(), ordinal,
+                [](uint32_t value, const std::shared_ptr<const IndexSegment>& segment) {
+                    return value < segment->GetEndOrdinal();
+                });
+            segment_indexes.push_back(it - sealed_segments_.begin());
+        }
+    }
+    std::sort(term_ids.begin(), term_ids.end());
+    term_ids.erase(std::unique(term_ids.begin(), term_ids.end()), term_ids.end());
+    std::for_each(policy, term_ids.begin(), term_ids.end(), [this](TermId term_id) {
+        write_segment_.Purge(term_id, removed_documents_);
     });
-    for_each(std::execution::par, words.begin(), words.end(), [this, document_id](const auto& word) {
-        word_to_document_freqs_.at(word).erase(document_id);
+
+    // Sealed segments are immutable, so the ones holding removed documents are rebuilt
+    std::sort(segment_indexes.begin(), segment_indexes.end());
+    segment_indexes.erase(std::unique(segment_indexes.begin(), segment_indexes.end()), segment_indexes.end());
+    std::for_each(policy, segment_indexes.begin(), segment_indexes.end(), [this](size_t segment_index) {
+        const IndexSegment* segment = sealed_segments_[segment_index].get();
+        sealed_segments_[segment_index] = std::make_shared<const IndexSegment>(IndexSegment::Merge({ segment }, removed_documents_));
     });
-    word_freqs_.erase(document_id);
+
+    forward_index_.Purge(removed_documents_);
+    removed_documents_ = DocumentBitmap();
+    pending_removals_.clear();
 }
 
-void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id){
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
-    const auto& word_freqs = word_freqs_.at(document_id);
-    std::vector<std::string> words(word_freqs.size());
-    transform(std::execution::seq, word_freqs.begin(), word_freqs.end(), words.begin(), [](const auto& word) {
-        return word.first;
-    });
-    for(auto& word : words){
-        word_to_document_freqs_.at(word).erase(document_id);
+void SearchServer::MaintainSegments() {
+    if (write_segment_.GetOrdinalCount() >= WRITE_SEGMENT_SIZE) {
+        write_segment_.Seal();
+        const uint32_t end_ordinal = write_segment_.GetEndOrdinal();
+        sealed_segments_.push_back(std::make_shared<const IndexSegment>(std::move(write_segment_)));
+        write_segment_ = IndexSegment(end_ordinal);
+    }
+    if (pending_merge_ && pending_merge_->merged.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        FinishMerge();
     }
-    word_freqs_.erase(document_id);
-}
\ No newline at end of file
+    if (!pending_merge_) {
+        StartMerge();
+    }
+}
+
+namespace {
+
+// Segments of WRITE_SEGMENT_SIZE ordinals are tier 0; every merge moves up one tier
+int GetSegmentTier(const IndexSegment& segment) {
+    int tier = 0;
+    for (uint64_t size = uint64_t{WRITE_SEGMENT_SIZE} * SEGMENT_MERGE_FACTOR; segment.GetOrdinalCount() >= size; size *= SEGMENT_MERGE_FACTOR) {
+        ++tier;
+    }
+    return tier;
+}
+
+} // namespace
+
+void SearchServer::StartMerge() {
+    // The newest segments are the smallest, so equal tiers can only line up at the end
+    if (sealed_segments_.size() < SEGMENT_MERGE_FACTOR) {
+        return;
+    }
+    const size_t first_segment = sealed_segments_.size() - SEGMENT_MERGE_FACTOR;
+    const int tier = GetSegmentTier(*sealed_segments_[first_segment]);
+    for (size_t i = first_segment + 1; i < sealed_segments_.size(); ++i) {
+        if (GetSegmentTier(*sealed_segments_[i]) != tier) {
+            return;
+        }
+    }
+
+    // The merge only reads immutable segments and its own copy of the removed
+    // documents, so queries and new documents carry on while it runs
+    std::vector<std::shared_ptr<const IndexSegment>> segments(sealed_segments_.begin() + first_segment, sealed_segments_.end());
+    pending_merge_ = PendingMerge{ first_segment, SEGMENT_MERGE_FACTOR,
+        std::async(std::launch::async, [segments = std::move(segments), removed = removed_documents_] {
+            std::vector<const IndexSegment*> sources;
+            for (const auto& segment : segments) {
+                sources.push_back(segment.get());
+            }
+            return std::make_shared<const IndexSegment>(IndexSegment::Merge(sources, removed));
+        }) };
+}
+
+void SearchServer::FinishMerge() {
+    std::shared_ptr<const IndexSegment> merged = pending_merge_->merged.get();
+    const auto first = sealed_segments_.begin() + pending_merge_->first_segment;
+    sealed_segments_.erase(first + 1, first + pending_merge_->segment_count);
+    sealed_segments_[pending_merge_->first_segment] = std::move(merged);
+    pending_merge_.reset();
+}
+
+namespace {
+
+// What happened to a document, as stored in a snapshot
+enum class DocumentState : uint32_t {
+    LIVE,
+    // Removed, but its postings wait for compaction
+    REMOVED,
+    // Removed and compacted away; only the ordinal is still taken
+    PURGED,
+};
+
+struct DocumentRecord {
+    int32_t id;
+    int32_t rating;
+    int32_t status;
+    DocumentState state;
+    double inv_word_count;
+    uint64_t text_offset;
+    uint64_t text_size;
+};
+
+} // namespace
+
+void SearchServer::SaveSnapshot(const std::string& path) const {
+    SnapshotWriter writer(path);
+
+    writer.BeginSection(SnapshotSection::STOP_WORDS);
+    writer.Write(static_cast<uint64_t>(stop_words_.size()));
+    for (const std::string& word : stop_words_) {
+        writer.WriteString(word);
+    }
+
+    writer.BeginSection(SnapshotSection::SETTINGS);
+    writer.Write(static_cast<uint64_t>(max_result_document_count_));
+    writer.Write(static_cast<uint32_t>(retrieval_mode_));
+
+    writer.BeginSection(SnapshotSection::TERMS);
+    terms_.Save(writer);
+    writer.WriteArray(term_document_counts_.data(), term_document_counts_.size());
+
+    writer.BeginSection(SnapshotSection::DOCUMENTS);
+    std::vector<DocumentRecord> records;
+    records.reserve(documents_.size());
+    uint64_t text_size = 0;
+    for (uint32_t ordinal = 0; ordinal < documents_.size(); ++ordinal) {
+        const DocumentData& document = documents_[ordinal];
+        const DocumentState state = live_documents_.Contains(ordinal) ? DocumentState::LIVE
+            : removed_documents_.Contains(ordinal) ? DocumentState::REMOVED : DocumentState::PURGED;
+        records.push_back({ document.id, document.rating, static_cast<int32_t>(document.status), state,
+                            document.inv_word_count, text_size, document.text.size() });
+        text_size += document.text.size();
+    }
+    writer.WriteArray(records.data(), records.size());
+    writer.Write(text_size);
+    for (const DocumentData& document : documents_) {
+        writer.WriteRaw(document.text.data(), document.text.size());
+    }
+    writer.Align();
+
+    writer.BeginSection(SnapshotSection::FORWARD_INDEX);
+    forward_index_.Save(writer);
+
+    // A merge still running only replaces segments that are saved as they are
+    writer.BeginSection(SnapshotSection::SEGMENTS);
+    writer.Write(static_cast<uint64_t>(sealed_segments_.size()));
+    for (const auto& segment : sealed_segments_) {
+        segment->Save(writer);
+    }
+    write_segment_.Save(writer);
+
+    writer.BeginSection(SnapshotSection::END);
+    writer.Commit();
+}
+
+SearchServer SearchServer::LoadSnapshot(const std::string& path, bool verify_checksum) {
+    SnapshotReader reader(path, verify_checksum);
+    return SearchServer(reader);
+}
+
+std::vector<std::string> SearchServer::ReadStopWords(SnapshotReader& reader) {
+    reader.ExpectSection(SnapshotSection::STOP_WORDS);
+    std::vector<std::string> stop_words(reader.Read<uint64_t>());
+    for (std::string& word : stop_words) {
+        word = reader.ReadString();
+    }
+    return stop_words;
+}
+
+SearchServer::SearchServer(SnapshotReader& reader)
+    : SearchServer(ReadStopWords(reader))
+{
+    snapshot_ = reader.GetFile();
+
+    reader.ExpectSection(SnapshotSection::SETTINGS);
+    max_result_document_count_ = reader.Read<uint64_t>();
+    retrieval_mode_ = static_cast<RetrievalMode>(reader.Read<uint32_t>());
+
+    reader.ExpectSection(SnapshotSection::TERMS);
+    terms_ = TermDictionary::Load(reader);
+    const auto term_document_counts = reader.ReadArray<uint32_t>();
+    if (term_document_counts.size() != terms_.size()) {
+        SnapshotReader::ThrowCorrupt();
+    }
+    term_document_counts_.assign(term_document_counts.begin(), term_document_counts.end());
+
+    // Document ids usually grow with ordinals, which makes every insertion hint exact
+    reader.ExpectSection(SnapshotSection::DOCUMENTS);
+    const auto records = reader.ReadArray<DocumentRecord>();
+    const std::string_view texts = reader.ReadString();
+    documents_.reserve(records.size());
+    for (const DocumentRecord& record : records) {
+        if (record.text_offset > texts.size() || record.text_size > texts.size() - record.text_offset) {
+            SnapshotReader::ThrowCorrupt();
+        }
+        const uint32_t ordinal = static_cast<uint32_t>(documents_.size());
+        const DocumentStatus status = static_cast<DocumentStatus>(record.status);
+        documents_.push_back({ record.id, record.rating, status, record.inv_word_count,
+                               texts.substr(record.text_offset, record.text_size) });
+        if (record.state == DocumentState::LIVE) {
+            if (document_ordinals_.emplace_hint(document_ordinals_.end(), record.id, ordinal)->second != ordinal) {
+                SnapshotReader::ThrowCorrupt();
+            }
+            document_ids_.emplace_hint(document_ids_.end(), record.id);
+            documents_by_status_[status].Add(ordinal);
+            live_documents_.Add(ordinal);
+        } else if (record.state == DocumentState::REMOVED) {
+            removed_documents_.Add(ordinal);
+            pending_removals_.push_back(ordinal);
+        }
+    }
+
+    reader.ExpectSection(SnapshotSection::FORWARD_INDEX);
+    forward_index_ = ForwardIndex::Load(reader);
+    if (forward_index_.size() != documents_.size()) {
+        SnapshotReader::ThrowCorrupt();
+    }
+
+    reader.ExpectSection(SnapshotSection::SEGMENTS);
+    const uint64_t segment_count = reader.Read<uint64_t>();
+    uint32_t end_ordinal = 0;
+    for (uint64_t i = 0; i <= segment_count; ++i) {
+        IndexSegment segment = IndexSegment::Load(reader);
+        if (segment.GetFirstOrdinal() != end_ordinal) {
+            SnapshotReader::ThrowCorrupt();
+        }
+        end_ordinal = segment.GetEndOrdinal();
+        if (i < segment_count) {
+            sealed_segments_.push_back(std::make_shared<const IndexSegment>(std::move(segment)));
+        } else {
+            // The write segment was saved sealed; it takes new documents again
+            segment.Reopen();
+            write_segment_ = std::move(segment);
+        }
+    }
+    if (end_ordinal != documents_.size()) {
+        SnapshotReader::ThrowCorrupt();
+    }
+    reader.ExpectSection(SnapshotSection::END);
+}
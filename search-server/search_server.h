@@ -9,14 +9,75 @@
 #include <set>
 #include <cmath>
 #include <execution>
+#include <numeric>
+#include <thread>
+#include <limits>
+#include <memory>
+#include <future>
+#include <optional>
 #include "document.h"
 #include "read_input_functions.h"
 #include "string_processing.h"
-#include "log_duration.h"
-#include "concurrent_map.h"
+#include "profiler.h"
+#include "term_dictionary.h"
+#include "posting_list.h"
+#include "index_segment.h"
+#include "relevance_accumulator.h"
+#include "top_documents.h"
+#include "document_bitmap.h"
+#include "string_arena.h"
+#include "forward_index.h"
+#include "corpus_statistics.h"
+#include "snapshot.h"
+#include "query_result_cache.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5; 
-const double EPSILON = 1e-6; 
+// Smallest ordinal range worth handing to a separate thread when scoring in parallel
+const uint32_t MIN_PARALLEL_PART_SIZE = 4096;
+// Removed documents stay in posting lists until there are at least this many
+// of them and they make up a quarter of the live ones; then the removal that
+// crosses the threshold purges them before it returns. This is synchronous on
+// purpose: the threshold spreads the rewrite over the removals before it, and
+// a purge on another thread would have to replay the removals made meanwhile.
+const size_t MIN_COMPACTION_REMOVALS = 1024;
+// Smallest slice of an AddDocuments batch tokenized by one thread
+const size_t MIN_INGEST_CHUNK_SIZE = 256;
+// New documents go to a write segment that is sealed once it covers this many ordinals
+const uint32_t WRITE_SEGMENT_SIZE = 16384;
+// This many adjacent sealed segments of one size tier are merged into a segment of the next tier
+const size_t SEGMENT_MERGE_FACTOR = 4;
+// Score slots shared by the queries FindTopDocumentsBatch scores together;
+// each query gets an equal share of the ordinals scored at a time
+const size_t BATCH_SCORE_SLOT_COUNT = 1 << 17;
+// Fewest ordinals scored at a time by FindTopDocumentsBatch
+const uint32_t MIN_BATCH_WINDOW_SIZE = 256;
+// Larger batches are scored in groups of this many queries, one pass over the postings each
+const size_t MAX_BATCH_QUERY_COUNT = BATCH_SCORE_SLOT_COUNT / MIN_BATCH_WINDOW_SIZE;
+
+// How FindTopDocuments walks the posting lists. Both modes return the same documents.
+enum class RetrievalMode {
+    // Score every posting of every plus word
+    EXHAUSTIVE,
+    // Skip documents whose best possible relevance cannot enter the current top
+    MAX_SCORE,
+};
+
+// One document of an AddDocuments batch
+struct DocumentToAdd {
+    int id;
+    std::string_view text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+// A document of an AddDocuments batch that was not added
+struct RejectedDocument {
+    // Position in the batch
+    size_t index;
+    int document_id;
+    // What AddDocument would have thrown
+    std::string reason;
+};
 
 class SearchServer {
 public:
@@ -29,6 +90,13 @@ public:
     void AddDocument(int document_id, std::string_view document, DocumentStatus status,
                      const std::vector<int>& ratings);
 
+    // Same as calling AddDocument for each document in order, except that a
+    // rejected document is reported instead of stopping the batch. The parallel
+    // overload tokenizes slices of the batch on separate threads.
+    std::vector<RejectedDocument> AddDocuments(const std::vector<DocumentToAdd>& documents);
+    std::vector<RejectedDocument> AddDocuments(const std::execution::parallel_policy&, const std::vector<DocumentToAdd>& documents);
+    std::vector<RejectedDocument> AddDocuments(const std::execution::sequenced_policy&, const std::vector<DocumentToAdd>& documents);
+
     template <typename DocumentPredicate, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
 
@@ -43,7 +111,42 @@ public:
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query) const;
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+    // Caches what FindTopDocuments returns for a status, keyed by the parsed
+    // query; changes to the index invalidate the entries. Must not overlap queries.
+    void EnableResultCache(QueryResultCacheOptions options = {});
+    void DisableResultCache();
+    // All zeros while the cache is disabled
+    QueryResultCacheStats GetResultCacheStats() const;
+
+    // Changes whenever the documents or settings that decide query results change
+    uint64_t GetEpoch() const;
+
+    // Same results as FindTopDocuments for each query in turn. The queries are
+    // parsed up front and grouped by plus word, so each posting list is read
+    // once per MAX_BATCH_QUERY_COUNT queries and its scores go to every query
+    // that has the word. Throws std::invalid_argument for the first invalid query.
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries, DocumentStatus status) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string_view>& raw_queries) const;
+
     int GetDocumentCount() const;
+    bool HasDocument(int document_id) const;
+
+    // Throws the std::invalid_argument AddDocument throws for an invalid text
+    static void CheckDocumentText(std::string_view document);
+
+    // Live documents containing the word
+    int GetDocumentFreq(std::string_view word) const;
+
+    // Makes IDF come from `statistics` instead of this server's own documents;
+    // nullptr restores the default. The statistics must outlive the server.
+    void SetCorpusStatistics(const CorpusStatistics* statistics);
+
+    // Number of documents FindTopDocuments returns, MAX_RESULT_DOCUMENT_COUNT by default
+    void SetMaxResultDocumentCount(size_t count);
+    size_t GetMaxResultDocumentCount() const;
+
+    void SetRetrievalMode(RetrievalMode mode);
+    RetrievalMode GetRetrievalMode() const;
 
     int GetDocumentId(int index) const;
 
@@ -56,17 +159,56 @@ public:
         return document_ids_.end();
     }
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // (term id, frequency) pairs of a document sorted by term id, viewed in place;
+    // empty for unknown documents
+    ForwardIndex::Range GetTermFrequencies(int document_id) const;
+
+    std::string_view GetTerm(uint32_t term_id) const;
+
+    // Compatibility view of GetTermFrequencies keyed by term text, built on every call
+    std::map<std::string_view, double> GetWordFrequencies(int document_id) const;
+
+    // Copy of the text passed to AddDocument, owned by the server
+    std::string_view GetDocumentText(int document_id) const;
+
+    // Bytes allocated for document texts and indexed terms
+    size_t GetTextMemoryUsage() const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::parallel_policy&,const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::execution::sequenced_policy&,const std::string_view raw_query, int document_id) const;
 
+    // The document leaves search results at once; its postings are dropped
+    // later by Compact, which this runs itself at MIN_COMPACTION_REMOVALS
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
 
-    void RemoveDuplicates(SearchServer& search_server);
+    // Removes all listed documents, then rewrites each affected posting list once.
+    // Unknown ids are skipped.
+    void RemoveDocuments(const std::vector<int>& document_ids);
+    void RemoveDocuments(const std::execution::parallel_policy&, const std::vector<int>& document_ids);
+    void RemoveDocuments(const std::execution::sequenced_policy&, const std::vector<int>& document_ids);
+
+    // Drops the postings of removed documents. RemoveDocument calls it on the
+    // calling thread once enough removals pile up (see MIN_COMPACTION_REMOVALS);
+    // it can also be run when idle.
+    void Compact();
+    void Compact(const std::execution::parallel_policy&);
+    void Compact(const std::execution::sequenced_policy&);
+
+    // Removed documents whose postings are still waiting for Compact
+    size_t GetPendingRemovalCount() const;
+
+    // Writes the whole index to `path` in the layout LoadSnapshot maps into memory.
+    // The previous file at `path` is replaced only once the new one is complete.
+    void SaveSnapshot(const std::string& path) const;
+
+    // Posting lists, the forward index and term and document texts are used
+    // straight from the mapped file, whose pages every process loading it
+    // shares; only the lookup tables are rebuilt. New documents go to memory as
+    // usual. Throws std::runtime_error if the file cannot be used.
+    static SearchServer LoadSnapshot(const std::string& path, bool verify_checksum = true);
 
     auto& GetWordsWithIds(){
         return words_with_ids_;
@@ -74,16 +216,56 @@ public:
 private:
 
     struct DocumentData {
+        int id;
         int rating;
         DocumentStatus status;
+        // Term frequency is the term's count in the document times this
+        double inv_word_count;
+        std::string_view text;
     };
 
+    using TermId = TermDictionary::TermId;
+
+    // Snapshot that texts and the forward index may point into; destroyed last
+    std::shared_ptr<const MappedFile> snapshot_;
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, DocumentData> documents_;
+    // The same words, for lookups while tokenizing
+    const StopWordSet stop_word_set_;
+    TermDictionary terms_;
+    StringArena document_texts_;
+    // Sealed segments in ordinal order; the write segment follows the last one
+    std::vector<std::shared_ptr<const IndexSegment>> sealed_segments_;
+    IndexSegment write_segment_{0};
+    // Live documents containing each term, over all segments; segments may still hold removed ones
+    std::vector<uint32_t> term_document_counts_;
+    // Indexed by internal ordinal; posting lists refer to documents by ordinal
+    std::vector<DocumentData> documents_;
+    std::map<int, uint32_t> document_ordinals_;
+    std::map<DocumentStatus, DocumentBitmap> documents_by_status_;
+    DocumentBitmap live_documents_;
+    // Removed documents that are still referenced by posting lists
+    DocumentBitmap removed_documents_;
+    std::vector<uint32_t> pending_removals_;
     std::set<int> document_ids_;
-    std::map<int, std::map<std::string_view, double>> word_freqs_;
+    ForwardIndex forward_index_;
     std::map<int, std::set<std::string>> words_with_ids_;
+    size_t max_result_document_count_ = MAX_RESULT_DOCUMENT_COUNT;
+    RetrievalMode retrieval_mode_ = RetrievalMode::EXHAUSTIVE;
+    const CorpusStatistics* corpus_statistics_ = nullptr;
+    uint64_t epoch_ = 0;
+    std::unique_ptr<QueryResultCache> result_cache_;
+
+    // Sealed segments [first_segment, first_segment + segment_count) being merged on another thread
+    struct PendingMerge {
+        size_t first_segment;
+        size_t segment_count;
+        std::future<std::shared_ptr<const IndexSegment>> merged;
+    };
+    std::optional<PendingMerge> pending_merge_;
+
+    explicit SearchServer(SnapshotReader& reader);
+
+    static std::vector<std::string> ReadStopWords(SnapshotReader& reader);
 
     bool IsStopWord(std::string_view word) const;
 
@@ -93,14 +275,37 @@ private:
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    // Index for a new term id, registered before its first posting
+    TermId InsertTerm(std::string_view word);
+
+    // Stores everything but the postings of a document whose ordinal is documents_.size()
+    void AppendDocumentData(int document_id, std::string_view document, DocumentStatus status,
+                            const std::vector<int>& ratings, double inv_word_count,
+                            std::vector<TermFrequency>& term_freqs);
+
+    // Postings of a slice of an AddDocuments batch, built before the documents get ordinals
+    struct PartialIndex;
+
+    PartialIndex BuildPartialIndex(const DocumentToAdd* first, const DocumentToAdd* last) const;
+
+    void MergePartialIndex(const PartialIndex& partial_index, const std::vector<DocumentToAdd>& documents,
+                           size_t first_index, std::vector<RejectedDocument>& rejected);
+
+    template <typename ExecutionPolicy>
+    std::vector<RejectedDocument> AddDocumentBatch(ExecutionPolicy&& policy, const std::vector<DocumentToAdd>& documents);
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
     };
 
+    // The word must be free of control characters
     QueryWord ParseQueryWord(std::string_view text) const;
 
+    // Words of a query; throws std::invalid_argument for the first invalid one
+    std::vector<std::string_view> SplitQueryWords(std::string_view text) const;
+
     
     struct Query {
         std::vector<std::string_view> plus_words;
@@ -111,21 +316,116 @@ private:
 
     Query ParseQueryParallel(std::string_view text) const;
         
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    // Returns NO_TERM for words that no live document contains
+    TermId FindLiveTerm(std::string_view word) const;
+
+    double ComputeWordInverseDocumentFreq(TermId term_id) const;
+
+    // Appends the results of up to MAX_BATCH_QUERY_COUNT parsed queries
+    void FindTopDocumentsBatchPart(const Query* queries, size_t query_count, DocumentStatus status,
+                                   std::vector<std::vector<Document>>& results) const;
+
+    // The query's words and everything else besides the index that decides its results
+    std::string MakeResultCacheKey(const Query& query, DocumentStatus status) const;
+    // epoch_, plus the version of shared corpus statistics if there are any.
+    // Never decreases, which QueryResultCache relies on.
+    uint64_t GetResultEpoch() const;
+
+    // Takes the document out of every lookup structure but the posting lists;
+    // returns false for unknown ids
+    bool MarkRemoved(int document_id);
+
+    bool NeedsCompaction() const;
+
+    template <typename ExecutionPolicy>
+    void PurgeRemovedDocuments(ExecutionPolicy&& policy);
+
+    // Seals a full write segment, installs a finished merge and starts the next one
+    void MaintainSegments();
+    void StartMerge();
+    void FinishMerge();
+
+    // Calls function(const IndexSegment&) for every segment that covers ordinals
+    // of [first_ordinal, last_ordinal), in ordinal order
+    template <typename Function>
+    void ForEachSegment(uint32_t first_ordinal, uint32_t last_ordinal, Function function) const;
+
+    // Scratch scores of the calling thread, reused across queries
+    static RelevanceAccumulator& GetThreadAccumulator(size_t document_count);
+
+    std::vector<Document> SelectTopDocuments(const RelevanceAccumulator& relevance_doc) const;
+
+    // Documents a query may return: those in `allowed` that contain no minus
+    // word. Both filters are merged with one AND-NOT up front, so scoring only
+    // tests one bitmap per posting.
+    class CandidateFilter {
+    public:
+        CandidateFilter(const DocumentBitmap* allowed, DocumentBitmap excluded);
+        CandidateFilter(const CandidateFilter&) = delete;
+        CandidateFilter& operator=(const CandidateFilter&) = delete;
+
+        bool Accepts(uint32_t ordinal) const {
+            return allowed_->Contains(ordinal);
+        }
 
-     template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+        // True when no document can pass
+        bool IsEmpty() const {
+            return allowed_->empty();
+        }
+
+    private:
+        const DocumentBitmap* allowed_;
+        DocumentBitmap excluded_;
+        DocumentBitmap allowed_storage_;
+    };
+
+    // Bitmap of documents that contain any of the query's minus words
+    DocumentBitmap CollectMinusWordDocuments(const Query& query) const;
+    // Documents of `allowed` without the query's minus words
+    CandidateFilter MakeCandidateFilter(const Query& query, const DocumentBitmap* allowed) const;
+
+    // Documents with the given status; an empty bitmap if there are none
+    const DocumentBitmap& GetDocumentsWithStatus(DocumentStatus status) const;
+
+    template<typename DocumentPredicate>
+    void AccumulateRelevance(RelevanceAccumulator& relevance_doc, const Query& query, const CandidateFilter& filter,
+                             DocumentPredicate& document_predicate, uint32_t first_ordinal, uint32_t last_ordinal) const;
+
+    // Position of one plus word's posting list while documents are visited in ordinal order
+    struct TermCursor {
+        PostingList::Cursor postings;
+        double inverse_document_freq;
+        double max_relevance;
+    };
+
+    // Cursors over the segment's postings in [first_ordinal, last_ordinal), sorted by max_relevance ascending
+    std::vector<TermCursor> MakeTermCursors(const Query& query, const IndexSegment& segment,
+                                            uint32_t first_ordinal, uint32_t last_ordinal) const;
+
+    // Adds the segment's documents that can still enter the top to top_documents
+    template<typename DocumentPredicate>
+    void FindBestDocumentsMaxScore(const Query& query, const CandidateFilter& filter, DocumentPredicate& document_predicate,
+                                   const IndexSegment& segment, uint32_t first_ordinal, uint32_t last_ordinal,
+                                   TopDocuments& top_documents) const;
 
     template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindBestDocumentsInRange(const Query& query, const CandidateFilter& filter, DocumentPredicate& document_predicate,
+                                                   uint32_t first_ordinal, uint32_t last_ordinal) const;
+
+    // Return the best max_result_document_count_ matches among `allowed`, most relevant first
+    template<typename DocumentPredicate>
+    std::vector<Document> FindBestDocuments(const std::execution::sequenced_policy& policy, const Query& query,
+                                            DocumentPredicate document_predicate, const DocumentBitmap* allowed) const;
     
     template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindBestDocuments(const std::execution::parallel_policy& policy, const Query& query,
+                                            DocumentPredicate document_predicate, const DocumentBitmap* allowed) const;
 };
 
 template <typename StringContainer>
 SearchServer::SearchServer(const StringContainer &stop_words)
         : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
+        , stop_word_set_(stop_words_)
 {
     if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
         throw std::invalid_argument("Some of stop words are invalid");
@@ -135,24 +435,7 @@ SearchServer::SearchServer(const StringContainer &stop_words)
 
 template <typename DocumentPredicate, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    auto matched_documents = FindAllDocuments(policy, raw_query, document_predicate);
-
-    std::sort(policy,
-        matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPSILON) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
-        });
-
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
-
-    return matched_documents;
+    return FindBestDocuments(policy, ParseQuery(raw_query), document_predicate, &live_documents_);
 }
 
 template <typename DocumentPredicate>
@@ -162,10 +445,24 @@ std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
 
 template <typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(policy, raw_query,
-        [&status](int document_id, DocumentStatus new_status, int rating) {
-            return new_status == status;
-    });
+    const Query query = ParseQuery(raw_query);
+    std::string cache_key;
+    if (result_cache_ != nullptr) {
+        cache_key = MakeResultCacheKey(query, status);
+        std::vector<Document> documents;
+        if (result_cache_->Find(cache_key, GetResultEpoch(), documents)) {
+            return documents;
+        }
+    }
+    // The status is checked against a bitmap before scoring instead of per posting
+    auto documents = FindBestDocuments(policy, query,
+        [](int, DocumentStatus, int) {
+            return true;
+    }, &GetDocumentsWithStatus(status));
+    if (result_cache_ != nullptr) {
+        result_cache_->Insert(cache_key, GetResultEpoch(), documents);
+    }
+    return documents;
 }
 
 template <typename ExecutionPolicy>
@@ -174,108 +471,200 @@ std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, s
 }
 
 template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query);
-    std::map<int, double> relevance_doc;
-
-    for (auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(std::string(word)) == 0) {
-            continue;
-        }
-        const double inverse_document_ = ComputeWordInverseDocumentFreq(word);
-        for (auto [document_id, term_freq] : word_to_document_freqs_.at(std::string(word))) {
-            const DocumentData& documents_data = documents_.at(document_id);
-            if (document_predicate(document_id, documents_data.status, documents_data.rating)) {
-                relevance_doc[document_id] += term_freq * inverse_document_;
+void SearchServer::AccumulateRelevance(RelevanceAccumulator& relevance_doc, const Query& query, const CandidateFilter& filter,
+                                       DocumentPredicate& document_predicate, uint32_t first_ordinal, uint32_t last_ordinal) const {
+    // Word by word and segment by segment, the order scores are summed in
+    struct TermPostings {
+        PostingList::View postings;
+        double inverse_document_freq;
+    };
+    std::vector<TermPostings> term_postings;
+    {
+        PROFILE_STAGE(ProfileStage::POSTING_LOOKUP);
+        for (auto word : query.plus_words) {
+            const TermId term_id = FindLiveTerm(word);
+            if (term_id == TermDictionary::NO_TERM) {
+                continue;
             }
+            const double inverse_document_freq = ComputeWordInverseDocumentFreq(term_id);
+            ForEachSegment(first_ordinal, last_ordinal, [&](const IndexSegment& segment) {
+                const PostingList::View postings = segment.Find(term_id);
+                if (!postings.empty()) {
+                    term_postings.push_back({ postings, inverse_document_freq });
+                }
+            });
         }
     }
-    
-    for (auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(std::string(word)) == 0) {
-            continue;
-        }
-        for (const auto& [document_id, term_freq] : word_to_document_freqs_.at(std::string(word))) {
-            relevance_doc.erase(document_id);
+
+    PROFILE_STAGE(ProfileStage::SCORING);
+    for (const auto& [postings, inverse_document_freq] : term_postings) {
+        for (PostingList::Cursor cursor(postings, first_ordinal, last_ordinal); !cursor.AtEnd(); cursor.Next()) {
+            const uint32_t ordinal = cursor.GetOrdinal();
+            if (!filter.Accepts(ordinal)) {
+                continue;
+            }
+            const DocumentData& document_data = documents_[ordinal];
+            if (document_predicate(document_data.id, document_data.status, document_data.rating)) {
+                const double term_freq = cursor.GetCount() * document_data.inv_word_count;
+                relevance_doc.Add(ordinal, term_freq * inverse_document_freq);
+            }
         }
     }
+}
 
-    std::vector<Document> matched_documents;
-    for (auto [document_id, relevance] : relevance_doc) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+template <typename Function>
+void SearchServer::ForEachSegment(uint32_t first_ordinal, uint32_t last_ordinal, Function function) const {
+    auto it = std::upper_bound(sealed_segments_.begin(), sealed_segments_.end(), first_ordinal,
+        [](uint32_t ordinal, const std::shared_ptr<const IndexSegment>& segment) {
+            return ordinal < segment->GetEndOrdinal();
+        });
+    for (; it != sealed_segments_.end() && (*it)->GetFirstOrdinal() < last_ordinal; ++it) {
+        function(**it);
+    }
+    if (write_segment_.GetFirstOrdinal() < last_ordinal && first_ordinal < write_segment_.GetEndOrdinal()) {
+        function(write_segment_);
     }
-    return matched_documents;
 }
 
 template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    std::map<int, double> relevance_doc;
-    const auto query = ParseQuery(raw_query);
+void SearchServer::FindBestDocumentsMaxScore(const Query& query, const CandidateFilter& filter, DocumentPredicate& document_predicate,
+                                             const IndexSegment& segment, uint32_t first_ordinal, uint32_t last_ordinal,
+                                             TopDocuments& top_documents) const {
+    // Relevance bounds are sums of doubles in a different order than the exact
+    // scores, so keep a margin well above rounding error but far below EPSILON
+    constexpr double BOUND_SLACK = 1e-9;
+
+    std::vector<TermCursor> cursors = MakeTermCursors(query, segment, first_ordinal, last_ordinal);
+    PROFILE_STAGE(ProfileStage::SCORING);
+    // bound_prefix[i] is the best relevance cursors [0, i] can add together
+    std::vector<double> bound_prefix(cursors.size());
+    double bound_sum = 0.0;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        bound_sum += cursors[i].max_relevance;
+        bound_prefix[i] = bound_sum + BOUND_SLACK;
+    }
 
-    for (auto word : query.plus_words) {
-        if (word_to_document_freqs_.count(std::string(word)) == 0) {
-            continue;
+    // A document has to reach this relevance to get into the top
+    double threshold = -std::numeric_limits<double>::infinity();
+    // Cursors before this one cannot lift a document over the threshold on their own,
+    // so only the rest (essential cursors) propose candidates
+    size_t first_essential = 0;
+    // The top carries over from earlier segments
+    const auto raise_threshold = [&] {
+        if (top_documents.IsFull()) {
+            threshold = top_documents.GetWorst().relevance - EPSILON;
+            while (first_essential < cursors.size() && bound_prefix[first_essential] < threshold) {
+                ++first_essential;
+            }
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(std::string(word))) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                relevance_doc[document_id] += term_freq * inverse_document_freq;
+    };
+    raise_threshold();
+
+    while (true) {
+        uint32_t candidate = last_ordinal;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            const TermCursor& cursor = cursors[i];
+            if (!cursor.postings.AtEnd()) {
+                candidate = std::min(candidate, cursor.postings.GetOrdinal());
             }
         }
-    }
+        if (candidate == last_ordinal) {
+            break;
+        }
 
-    for (auto word : query.minus_words) {
-        if (word_to_document_freqs_.count(std::string(word)) == 0) {
+        const DocumentData& document_data = documents_[candidate];
+        double relevance = 0.0;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            TermCursor& cursor = cursors[i];
+            if (!cursor.postings.AtEnd() && cursor.postings.GetOrdinal() == candidate) {
+                relevance += cursor.postings.GetCount() * document_data.inv_word_count * cursor.inverse_document_freq;
+                cursor.postings.Next();
+            }
+        }
+
+        if (!filter.Accepts(candidate)
+            || !document_predicate(document_data.id, document_data.status, document_data.rating)) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(std::string(word))) {
-            relevance_doc.erase(document_id);
+
+        bool pruned = false;
+        for (size_t i = first_essential; i-- > 0;) {
+            if (relevance + bound_prefix[i] < threshold) {
+                pruned = true;
+                break;
+            }
+            TermCursor& cursor = cursors[i];
+            cursor.postings.SeekTo(candidate);
+            if (!cursor.postings.AtEnd() && cursor.postings.GetOrdinal() == candidate) {
+                relevance += cursor.postings.GetCount() * document_data.inv_word_count * cursor.inverse_document_freq;
+            }
+        }
+        if (pruned) {
+            continue;
         }
+
+        top_documents.Add({ document_data.id, relevance, document_data.rating });
+        raise_threshold();
     }
+}
 
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : relevance_doc) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+template<typename DocumentPredicate>
+std::vector<Document> SearchServer::FindBestDocumentsInRange(const Query& query, const CandidateFilter& filter, DocumentPredicate& document_predicate,
+                                                             uint32_t first_ordinal, uint32_t last_ordinal) const {
+    if (retrieval_mode_ == RetrievalMode::MAX_SCORE) {
+        TopDocuments top_documents(max_result_document_count_);
+        ForEachSegment(first_ordinal, last_ordinal, [&](const IndexSegment& segment) {
+            FindBestDocumentsMaxScore(query, filter, document_predicate, segment, first_ordinal, last_ordinal, top_documents);
+        });
+        PROFILE_STAGE(ProfileStage::RESULT_BUILD);
+        return top_documents.Extract();
     }
-    return matched_documents;
+    RelevanceAccumulator& relevance_doc = GetThreadAccumulator(documents_.size());
+    AccumulateRelevance(relevance_doc, query, filter, document_predicate, first_ordinal, last_ordinal);
+    return SelectTopDocuments(relevance_doc);
 }
 
 template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query, DocumentPredicate document_predicate) const {
-    ConcurrentMap<int, double> relevance_doc(10);
-    const auto query = ParseQuery(raw_query);
+std::vector<Document> SearchServer::FindBestDocuments(const std::execution::sequenced_policy&, const Query& query,
+                                                      DocumentPredicate document_predicate, const DocumentBitmap* allowed) const {
+    const CandidateFilter filter = MakeCandidateFilter(query, allowed);
+    if (filter.IsEmpty()) {
+        return {};
+    }
+    return FindBestDocumentsInRange(query, filter, document_predicate, 0, static_cast<uint32_t>(documents_.size()));
+}
 
-    std::for_each(policy,
-        query.minus_words.begin(), query.minus_words.end(),
-        [this, &relevance_doc](std::string_view word) {
-            if (word_to_document_freqs_.count(std::string(word))) {
-                for (const auto [document_id, _] : word_to_document_freqs_.at(std::string(word))) {
-                    relevance_doc.Erase(document_id);
-                }
-            }
-    });
+template<typename DocumentPredicate>
+std::vector<Document> SearchServer::FindBestDocuments(const std::execution::parallel_policy& policy, const Query& query,
+                                                      DocumentPredicate document_predicate, const DocumentBitmap* allowed) const {
+    const CandidateFilter filter = MakeCandidateFilter(query, allowed);
+    if (filter.IsEmpty()) {
+        return {};
+    }
+    const uint32_t ordinal_count = static_cast<uint32_t>(documents_.size());
+
+    // Every part scores its own ordinal range for all query words, so parts
+    // never write to the same slot; each part keeps only its own best documents
+    const size_t max_part_count = std::max(1u, std::thread::hardware_concurrency()) * 4;
+    const size_t part_count = std::clamp<size_t>(ordinal_count / MIN_PARALLEL_PART_SIZE, 1, max_part_count);
+    std::vector<std::vector<Document>> parts(part_count);
 
+    std::vector<size_t> part_indexes(part_count);
+    std::iota(part_indexes.begin(), part_indexes.end(), 0);
     std::for_each(policy,
-        query.plus_words.begin(), query.plus_words.end(),
-        [this, &document_predicate, &relevance_doc](std::string_view word) {
-            if (word_to_document_freqs_.count(std::string(word))) {
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto [document_id, term_freq] : word_to_document_freqs_.at(std::string(word))) {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                        relevance_doc[document_id].ref_to_value += term_freq * inverse_document_freq;
-                    }
-                }
-            }
+        part_indexes.begin(), part_indexes.end(),
+        [&](size_t part) {
+            const uint32_t first_ordinal = static_cast<uint32_t>(uint64_t{ordinal_count} * part / part_count);
+            const uint32_t last_ordinal = static_cast<uint32_t>(uint64_t{ordinal_count} * (part + 1) / part_count);
+            parts[part] = FindBestDocumentsInRange(query, filter, document_predicate, first_ordinal, last_ordinal);
     });
 
-    std::map<int, double> document_reduced = relevance_doc.BuildOrdinaryMap();
-    std::vector<Document> matched_documents;
-    matched_documents.reserve(document_reduced.size());
-
-    for (const auto [document_id, relevance] : document_reduced) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    PROFILE_STAGE(ProfileStage::RESULT_BUILD);
+    TopDocuments top_documents(max_result_document_count_);
+    for (const auto& part : parts) {
+        for (const Document& document : part) {
+            top_documents.Add(document);
+        }
     }
-    return matched_documents;
+    return top_documents.Extract();
 }
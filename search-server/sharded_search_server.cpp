@@ -0,0 +1,127 @@
+#include "sharded_search_server.h"
+#include <algorithm>
+
+ShardedSearchServer::GlobalStatistics::GlobalStatistics(const ShardedSearchServer& server)
+    : server_(server)
+{
+}
+
+int ShardedSearchServer::GlobalStatistics::GetDocumentCount() const {
+    return server_.GetDocumentCount();
+}
+
+int ShardedSearchServer::GlobalStatistics::GetDocumentFreq(std::string_view word) const {
+    return server_.GetDocumentFreq(word);
+}
+
+uint64_t ShardedSearchServer::GlobalStatistics::GetVersion() const {
+    uint64_t version = 0;
+    for (const auto& shard : server_.shards_) {
+        version += shard->GetEpoch();
+    }
+    return version;
+}
+
+void ShardedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    shards_[GetShardIndex(document_id)]->AddDocument(document_id, document, status, ratings);
+}
+
+std::vector<RejectedDocument> ShardedSearchServer::AddDocuments(const std::vector<DocumentToAdd>& documents) {
+    std::vector<std::vector<DocumentToAdd>> parts(shards_.size());
+    // Position in `documents` of every entry of parts
+    std::vector<std::vector<size_t>> part_indexes(shards_.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const size_t shard = GetShardIndex(documents[i].id);
+        parts[shard].push_back(documents[i]);
+        part_indexes[shard].push_back(i);
+    }
+
+    std::vector<std::vector<RejectedDocument>> rejected_parts(shards_.size());
+    std::vector<size_t> shard_indexes(shards_.size());
+    std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    std::for_each(std::execution::par,
+        shard_indexes.begin(), shard_indexes.end(),
+        [&](size_t shard) {
+            rejected_parts[shard] = shards_[shard]->AddDocuments(parts[shard]);
+    });
+
+    std::vector<RejectedDocument> rejected;
+    for (size_t shard = 0; shard < shards_.size(); ++shard) {
+        for (RejectedDocument& document : rejected_parts[shard]) {
+            document.index = part_indexes[shard][document.index];
+            rejected.push_back(std::move(document));
+        }
+    }
+    std::sort(rejected.begin(), rejected.end(), [](const RejectedDocument& lhs, const RejectedDocument& rhs) {
+        return lhs.index < rhs.index;
+    });
+    return rejected;
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    shards_[GetShardIndex(document_id)]->RemoveDocument(document_id);
+}
+
+void ShardedSearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    std::vector<std::vector<int>> parts(shards_.size());
+    for (const int document_id : document_ids) {
+        parts[GetShardIndex(document_id)].push_back(document_id);
+    }
+    std::vector<size_t> shard_indexes(shards_.size());
+    std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    std::for_each(std::execution::par,
+        shard_indexes.begin(), shard_indexes.end(),
+        [&](size_t shard) {
+            shards_[shard]->RemoveDocuments(parts[shard]);
+    });
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+    return SearchShards([raw_query, status](const SearchServer& shard) {
+        return shard.FindTopDocuments(raw_query, status);
+    });
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    return shards_[GetShardIndex(document_id)]->MatchDocument(raw_query, document_id);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const auto& shard : shards_) {
+        document_count += shard->GetDocumentCount();
+    }
+    return document_count;
+}
+
+int ShardedSearchServer::GetDocumentFreq(std::string_view word) const {
+    int document_freq = 0;
+    for (const auto& shard : shards_) {
+        document_freq += shard->GetDocumentFreq(word);
+    }
+    return document_freq;
+}
+
+void ShardedSearchServer::SetMaxResultDocumentCount(size_t count) {
+    max_result_document_count_ = count;
+    for (const auto& shard : shards_) {
+        shard->SetMaxResultDocumentCount(count);
+    }
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+const SearchServer& ShardedSearchServer::GetShard(size_t index) const {
+    return *shards_[index];
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    // Negative ids still go to some shard, which rejects them like SearchServer does
+    return static_cast<unsigned int>(document_id) % shards_.size();
+}
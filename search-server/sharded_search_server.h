@@ -0,0 +1,125 @@
+#pragma once
+
+#include <exception>
+#include <execution>
+#include <memory>
+#include <numeric>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "corpus_statistics.h"
+#include "search_server.h"
+#include "top_documents.h"
+
+// Documents split by id across several SearchServer shards. A query runs on
+// every shard in parallel and the shards' top documents are merged. Shards take
+// IDF from the statistics of all shards together, so relevance is the same as
+// for a single SearchServer holding every document.
+class ShardedSearchServer {
+public:
+    template <typename StopWords>
+    ShardedSearchServer(const StopWords& stop_words, size_t shard_count);
+
+    // Shards keep a pointer to the statistics of their owner
+    ShardedSearchServer(const ShardedSearchServer&) = delete;
+    ShardedSearchServer& operator=(const ShardedSearchServer&) = delete;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // Every shard adds its part of the batch in parallel with the others
+    std::vector<RejectedDocument> AddDocuments(const std::vector<DocumentToAdd>& documents);
+
+    void RemoveDocument(int document_id);
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+    int GetDocumentFreq(std::string_view word) const;
+
+    void SetMaxResultDocumentCount(size_t count);
+
+    size_t GetShardCount() const;
+    const SearchServer& GetShard(size_t index) const;
+
+private:
+    // Sums the counts of all shards
+    class GlobalStatistics : public CorpusStatistics {
+    public:
+        explicit GlobalStatistics(const ShardedSearchServer& server);
+
+        int GetDocumentCount() const override;
+        int GetDocumentFreq(std::string_view word) const override;
+        uint64_t GetVersion() const override;
+
+    private:
+        const ShardedSearchServer& server_;
+    };
+
+    std::vector<std::unique_ptr<SearchServer>> shards_;
+    GlobalStatistics statistics_;
+    size_t max_result_document_count_ = MAX_RESULT_DOCUMENT_COUNT;
+
+    size_t GetShardIndex(int document_id) const;
+
+    // Runs search(const SearchServer&) on every shard at once and merges the results
+    template <typename Search>
+    std::vector<Document> SearchShards(Search search) const;
+};
+
+template <typename StopWords>
+ShardedSearchServer::ShardedSearchServer(const StopWords& stop_words, size_t shard_count)
+    : statistics_(*this)
+{
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive");
+    }
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<SearchServer>(stop_words));
+        shards_.back()->SetCorpusStatistics(&statistics_);
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return SearchShards([raw_query, &document_predicate](const SearchServer& shard) {
+        return shard.FindTopDocuments(raw_query, document_predicate);
+    });
+}
+
+template <typename Search>
+std::vector<Document> ShardedSearchServer::SearchShards(Search search) const {
+    std::vector<std::vector<Document>> results(shards_.size());
+    // A parallel algorithm terminates on exceptions, so they are carried out by hand
+    std::vector<std::exception_ptr> errors(shards_.size());
+    std::vector<size_t> shard_indexes(shards_.size());
+    std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    std::for_each(std::execution::par,
+        shard_indexes.begin(), shard_indexes.end(),
+        [&](size_t shard) {
+            try {
+                results[shard] = search(*shards_[shard]);
+            } catch (...) {
+                errors[shard] = std::current_exception();
+            }
+    });
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Each shard returns its best documents in the same total order, so the
+    // best of their union are the best of the whole corpus
+    TopDocuments top_documents(max_result_document_count_);
+    for (const auto& result : results) {
+        for (const Document& document : result) {
+            top_documents.Add(document);
+        }
+    }
+    return top_documents.Extract();
+}
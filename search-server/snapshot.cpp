@@ -0,0 +1,216 @@
+#include "snapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "forward_index.h"
+#include "posting_list.h"
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = { 'S', 'R', 'C', 'H', 'S', 'N', 'A', 'P' };
+const uint32_t SNAPSHOT_VERSION = 1;
+// Stored as written; a machine of the other byte order reads it differently
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    // Layouts of the structures the reader maps in place
+    uint32_t term_frequency_size;
+    uint32_t block_size;
+    uint64_t payload_size;
+    uint64_t checksum;
+};
+
+// FNV-1a over 64-bit words; the payload always has a whole number of them
+const uint64_t CHECKSUM_SEED = 14695981039346656037ull;
+
+uint64_t UpdateChecksum(uint64_t checksum, const uint8_t* bytes, size_t word_count) {
+    for (size_t i = 0; i < word_count; ++i) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i * 8, 8);
+        checksum = (checksum ^ word) * 1099511628211ull;
+    }
+    return checksum;
+}
+
+SnapshotHeader MakeHeader() {
+    SnapshotHeader header = {};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.term_frequency_size = sizeof(TermFrequency);
+    header.block_size = sizeof(PostingList::Block);
+    return header;
+}
+
+bool SyncDirectory(const std::string& path) {
+    const size_t slash = path.rfind('/');
+    const std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    const int descriptor = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (descriptor < 0) {
+        return false;
+    }
+    const bool synced = fsync(descriptor) == 0;
+    return close(descriptor) == 0 && synced;
+}
+
+} // namespace
+
+MappedFile::MappedFile(const std::string& path) {
+    const int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) != 0) {
+        close(descriptor);
+        throw std::runtime_error("Cannot map " + path);
+    }
+    // mmap rejects empty ranges
+    if (status.st_size == 0) {
+        close(descriptor);
+        return;
+    }
+    void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+    // The mapping holds its own reference to the file
+    close(descriptor);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + path);
+    }
+    data_ = static_cast<const uint8_t*>(data);
+    size_ = status.st_size;
+}
+
+MappedFile::~MappedFile() {
+    if (size_ > 0) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+    : path_(path)
+    , temporary_path_(path + ".tmp")
+    , checksum_(CHECKSUM_SEED)
+{
+    file_ = std::fopen(temporary_path_.c_str(), "wb");
+    if (file_ == nullptr) {
+        throw std::runtime_error("Cannot create " + temporary_path_);
+    }
+    // Filled in by Commit
+    const SnapshotHeader header = {};
+    std::fwrite(&header, sizeof(header), 1, file_);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (file_ != nullptr) {
+        std::fclose(file_);
+        std::remove(temporary_path_.c_str());
+    }
+}
+
+void SnapshotWriter::WriteRaw(const void* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    std::fwrite(data, 1, size, file_);
+    payload_size_ += size;
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    if (partial_size_ > 0) {
+        const size_t taken = std::min(size, sizeof(partial_word_) - partial_size_);
+        std::memcpy(partial_word_ + partial_size_, bytes, taken);
+        partial_size_ += taken;
+        bytes += taken;
+        size -= taken;
+        if (partial_size_ < sizeof(partial_word_)) {
+            return;
+        }
+        checksum_ = UpdateChecksum(checksum_, partial_word_, 1);
+        partial_size_ = 0;
+    }
+    checksum_ = UpdateChecksum(checksum_, bytes, size / 8);
+    partial_size_ = size % 8;
+    if (partial_size_ > 0) {
+        std::memcpy(partial_word_, bytes + size - partial_size_, partial_size_);
+    }
+}
+
+void SnapshotWriter::Align() {
+    static const uint8_t padding[8] = {};
+    WriteRaw(padding, (8 - payload_size_ % 8) % 8);
+}
+
+void SnapshotWriter::Commit() {
+    SnapshotHeader header = MakeHeader();
+    header.payload_size = payload_size_;
+    header.checksum = checksum_;
+    std::fseek(file_, 0, SEEK_SET);
+    std::fwrite(&header, sizeof(header), 1, file_);
+    const bool written = std::fflush(file_) == 0 && std::ferror(file_) == 0 && fsync(fileno(file_)) == 0;
+    const bool closed = std::fclose(file_) == 0;
+    file_ = nullptr;
+    if (!written || !closed || std::rename(temporary_path_.c_str(), path_.c_str()) != 0) {
+        std::remove(temporary_path_.c_str());
+        throw std::runtime_error("Cannot write " + path_);
+    }
+    // The rename is only durable once the directory holding it is synced
+    if (!SyncDirectory(path_)) {
+        throw std::runtime_error("Cannot sync the directory of " + path_);
+    }
+}
+
+SnapshotReader::SnapshotReader(const std::string& path, bool verify_checksum)
+    : file_(std::make_shared<const MappedFile>(path))
+    , position_(sizeof(SnapshotHeader))
+    , end_(sizeof(SnapshotHeader))
+{
+    if (file_->size() < sizeof(SnapshotHeader)) {
+        ThrowCorrupt();
+    }
+    SnapshotHeader header;
+    std::memcpy(&header, file_->data(), sizeof(header));
+    const SnapshotHeader expected = MakeHeader();
+    if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0) {
+        throw std::runtime_error(path + " is not a search server snapshot");
+    }
+    if (header.version != expected.version) {
+        throw std::runtime_error("Unsupported snapshot version " + std::to_string(header.version));
+    }
+    if (header.byte_order != expected.byte_order || header.term_frequency_size != expected.term_frequency_size
+        || header.block_size != expected.block_size) {
+        throw std::runtime_error("Snapshot was written on an incompatible machine");
+    }
+    if (header.payload_size % 8 != 0 || header.payload_size != file_->size() - sizeof(SnapshotHeader)) {
+        ThrowCorrupt();
+    }
+    end_ += header.payload_size;
+    if (verify_checksum && UpdateChecksum(CHECKSUM_SEED, file_->data() + position_, header.payload_size / 8) != header.checksum) {
+        throw std::runtime_error("Snapshot checksum mismatch");
+    }
+}
+
+void SnapshotReader::ExpectSection(SnapshotSection section) {
+    if (Read<uint64_t>() != static_cast<uint64_t>(section)) {
+        ThrowCorrupt();
+    }
+}
+
+void SnapshotReader::ThrowCorrupt() {
+    throw std::runtime_error("Corrupt snapshot");
+}
+
+const uint8_t* SnapshotReader::ReadBytes(size_t size) {
+    const size_t padded_size = (size + 7) / 8 * 8;
+    if (padded_size < size || padded_size > end_ - position_) {
+        ThrowCorrupt();
+    }
+    const uint8_t* bytes = file_->data() + position_;
+    position_ += padded_size;
+    return bytes;
+}
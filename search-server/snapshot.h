@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "paginator.h"
+
+// Parts of a snapshot in file order; each one starts with its tag
+enum class SnapshotSection : uint64_t {
+    STOP_WORDS = 1,
+    SETTINGS,
+    TERMS,
+    DOCUMENTS,
+    FORWARD_INDEX,
+    SEGMENTS,
+    END,
+};
+
+// Read-only mapping of a whole file. Pages are shared with every other process
+// that maps the same file. An empty file has no data.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Writes a snapshot to path + ".tmp" and renames it to path on Commit, so a
+// reader never sees a half-written file. Commit returns once the file and the
+// rename are on disk. Every value and array starts at a
+// multiple of 8 bytes, which lets the reader hand out pointers into the mapping.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+    // Deletes the temporary file unless Commit succeeded
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    void BeginSection(SnapshotSection section) {
+        Write(static_cast<uint64_t>(section));
+    }
+
+    template <typename T>
+    void Write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        WriteRaw(&value, sizeof(T));
+        Align();
+    }
+
+    // Element count followed by the elements
+    template <typename T>
+    void WriteArray(const T* values, size_t count) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Write(static_cast<uint64_t>(count));
+        WriteRaw(values, count * sizeof(T));
+        Align();
+    }
+
+    void WriteString(std::string_view text) {
+        WriteArray(text.data(), text.size());
+    }
+
+    // Bytes of one value or array written in several pieces; Align ends it
+    void WriteRaw(const void* data, size_t size);
+    void Align();
+
+    // Fills in the header, flushes the file to disk and moves it into place
+    void Commit();
+
+private:
+    std::string path_;
+    std::string temporary_path_;
+    std::FILE* file_ = nullptr;
+    uint64_t payload_size_ = 0;
+    uint64_t checksum_;
+    // Payload bytes not yet hashed because they do not fill a word
+    uint8_t partial_word_[8] = {};
+    size_t partial_size_ = 0;
+};
+
+// Sequential reader over a mapped snapshot. Arrays and strings point into the
+// mapping, which stays alive while GetFile() is held.
+class SnapshotReader {
+public:
+    // Throws std::runtime_error if the file is not a snapshot of this version,
+    // was written on an incompatible machine or fails the checksum
+    SnapshotReader(const std::string& path, bool verify_checksum);
+
+    // Throws std::runtime_error if the next tag is not `section`
+    void ExpectSection(SnapshotSection section);
+
+    template <typename T>
+    T Read() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return *reinterpret_cast<const T*>(ReadBytes(sizeof(T)));
+    }
+
+    template <typename T>
+    IteratorRange<const T*> ReadArray() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const uint64_t count = Read<uint64_t>();
+        if (count > (end_ - position_) / sizeof(T)) {
+            ThrowCorrupt();
+        }
+        const T* values = reinterpret_cast<const T*>(ReadBytes(count * sizeof(T)));
+        return IteratorRange<const T*>(values, values + count);
+    }
+
+    std::string_view ReadString() {
+        const auto chars = ReadArray<char>();
+        return std::string_view(chars.begin(), chars.size());
+    }
+
+    const std::shared_ptr<const MappedFile>& GetFile() const {
+        return file_;
+    }
+
+    [[noreturn]] static void ThrowCorrupt();
+
+private:
+    std::shared_ptr<const MappedFile> file_;
+    size_t position_;
+    size_t end_;
+
+    const uint8_t* ReadBytes(size_t size);
+};
@@ -0,0 +1,201 @@
+#include "stream_vbyte.h"
+#include <array>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STREAM_VBYTE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+size_t ControlBytes(size_t count) {
+    return (count + 3) / 4;
+}
+
+uint8_t EncodedLengthCode(uint32_t value) {
+    if (value < (1u << 8)) {
+        return 0;
+    }
+    if (value < (1u << 16)) {
+        return 1;
+    }
+    if (value < (1u << 24)) {
+        return 2;
+    }
+    return 3;
+}
+
+template <bool Delta>
+size_t Encode(const uint32_t* values, size_t count, uint32_t base, uint8_t* out) {
+    uint8_t* control = out;
+    uint8_t* data = out + ControlBytes(count);
+    std::fill(control, data, uint8_t{0});
+    uint32_t previous = base;
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t value = Delta ? values[i] - previous : values[i];
+        previous = values[i];
+        const uint8_t code = EncodedLengthCode(value);
+        control[i / 4] |= code << (2 * (i % 4));
+        for (int byte = 0; byte <= code; ++byte) {
+            *data++ = static_cast<uint8_t>(value >> (8 * byte));
+        }
+    }
+    return data - out;
+}
+
+// Decodes `count` values whose control bytes start at `control`, which must be
+// aligned to a group of four. Returns the end of the consumed data bytes.
+template <bool Delta>
+const uint8_t* DecodeValues(const uint8_t* control, const uint8_t* data, size_t count, uint32_t base, uint32_t* values) {
+    uint32_t previous = base;
+    for (size_t i = 0; i < count; ++i) {
+        const int code = (control[i / 4] >> (2 * (i % 4))) & 3;
+        uint32_t value = 0;
+        for (int byte = 0; byte <= code; ++byte) {
+            value |= static_cast<uint32_t>(*data++) << (8 * byte);
+        }
+        previous = Delta ? previous + value : value;
+        values[i] = previous;
+    }
+    return data;
+}
+
+template <bool Delta>
+size_t DecodeScalar(const uint8_t* in, size_t count, uint32_t base, uint32_t* values) {
+    return DecodeValues<Delta>(in, in + ControlBytes(count), count, base, values) - in;
+}
+
+#ifdef STREAM_VBYTE_X86
+
+// For every control byte: how many data bytes its four values take, and the
+// shuffle that moves those bytes into four 32-bit lanes
+struct ShuffleTables {
+    std::array<uint8_t, 256> lengths;
+    alignas(16) std::array<std::array<uint8_t, 16>, 256> shuffles;
+
+    ShuffleTables() {
+        for (int control = 0; control < 256; ++control) {
+            int source = 0;
+            for (int lane = 0; lane < 4; ++lane) {
+                const int length = ((control >> (2 * lane)) & 3) + 1;
+                for (int byte = 0; byte < 4; ++byte) {
+                    // 0xFF makes _mm_shuffle_epi8 write a zero byte
+                    shuffles[control][lane * 4 + byte] = byte < length ? static_cast<uint8_t>(source + byte) : 0xFF;
+                }
+                source += length;
+            }
+            lengths[control] = static_cast<uint8_t>(source);
+        }
+    }
+};
+
+const ShuffleTables& GetShuffleTables() {
+    static const ShuffleTables tables;
+    return tables;
+}
+
+template <bool Delta>
+__attribute__((target("ssse3")))
+size_t DecodeSsse3(const uint8_t* in, size_t count, uint32_t base, uint32_t* values) {
+    const ShuffleTables& tables = GetShuffleTables();
+    const uint8_t* control = in;
+    const uint8_t* data = in + ControlBytes(count);
+
+    // A 16-byte load may reach past the current group. The last three groups
+    // hold at least 12 bytes, so stopping before them never reads past the end.
+    const size_t groups = count / 4;
+    const size_t simd_groups = groups > 3 ? groups - 3 : 0;
+    __m128i previous = _mm_set1_epi32(static_cast<int>(base));
+    for (size_t group = 0; group < simd_groups; ++group) {
+        const uint8_t code = control[group];
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(tables.shuffles[code].data()));
+        __m128i decoded = _mm_shuffle_epi8(bytes, shuffle);
+        if (Delta) {
+            decoded = _mm_add_epi32(decoded, _mm_slli_si128(decoded, 4));
+            decoded = _mm_add_epi32(decoded, _mm_slli_si128(decoded, 8));
+            decoded = _mm_add_epi32(decoded, previous);
+            previous = _mm_shuffle_epi32(decoded, 0xFF);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + group * 4), decoded);
+        data += tables.lengths[code];
+    }
+
+    const size_t decoded_count = simd_groups * 4;
+    const uint32_t last = decoded_count > 0 ? values[decoded_count - 1] : base;
+    data = DecodeValues<Delta>(control + simd_groups, data, count - decoded_count, last, values + decoded_count);
+    return data - in;
+}
+
+#endif
+
+using DecodeFunction = size_t (*)(const uint8_t*, size_t, uint32_t, uint32_t*);
+
+template <bool Delta>
+DecodeFunction ChooseDecoder() {
+#ifdef STREAM_VBYTE_X86
+    if (IsStreamVByteSimdSupported()) {
+        return DecodeSsse3<Delta>;
+    }
+#endif
+    return DecodeScalar<Delta>;
+}
+
+}  // namespace
+
+size_t EncodeStreamVByte(const uint32_t* values, size_t count, uint8_t* out) {
+    return Encode<false>(values, count, 0, out);
+}
+
+size_t EncodeStreamVByteDeltas(const uint32_t* values, size_t count, uint32_t base, uint8_t* out) {
+    return Encode<true>(values, count, base, out);
+}
+
+size_t DecodeStreamVByte(const uint8_t* in, size_t count, uint32_t* values) {
+    static const DecodeFunction decode = ChooseDecoder<false>();
+    return decode(in, count, 0, values);
+}
+
+size_t DecodeStreamVByteDeltas(const uint8_t* in, size_t count, uint32_t base, uint32_t* values) {
+    static const DecodeFunction decode = ChooseDecoder<true>();
+    return decode(in, count, base, values);
+}
+
+size_t DecodeStreamVByteScalar(const uint8_t* in, size_t count, uint32_t* values) {
+    return DecodeScalar<false>(in, count, 0, values);
+}
+
+size_t DecodeStreamVByteDeltasScalar(const uint8_t* in, size_t count, uint32_t base, uint32_t* values) {
+    return DecodeScalar<true>(in, count, base, values);
+}
+
+bool IsStreamVByteSimdSupported() {
+#ifdef STREAM_VBYTE_X86
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3") != 0;
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+size_t DecodeStreamVByteSimd(const uint8_t* in, size_t count, uint32_t* values) {
+#ifdef STREAM_VBYTE_X86
+    if (IsStreamVByteSimdSupported()) {
+        return DecodeSsse3<false>(in, count, 0, values);
+    }
+#endif
+    return DecodeScalar<false>(in, count, 0, values);
+}
+
+size_t DecodeStreamVByteDeltasSimd(const uint8_t* in, size_t count, uint32_t base, uint32_t* values) {
+#ifdef STREAM_VBYTE_X86
+    if (IsStreamVByteSimdSupported()) {
+        return DecodeSsse3<true>(in, count, base, values);
+    }
+#endif
+    return DecodeScalar<true>(in, count, base, values);
+}
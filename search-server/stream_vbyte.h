@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Stream VByte integer codec. Every value takes 1-4 little-endian bytes; the
+// byte lengths of four consecutive values are packed into one control byte.
+// All control bytes come first, followed by the data bytes, so a decoder can
+// expand four values at once with a single byte shuffle.
+
+// Upper bound of the encoded size of `count` values
+constexpr size_t StreamVByteMaxBytes(size_t count) {
+    return (count + 3) / 4 + 4 * count;
+}
+
+// Returns the number of bytes written
+size_t EncodeStreamVByte(const uint32_t* values, size_t count, uint8_t* out);
+
+// Values stored as differences from the previous one, the first from `base`
+size_t EncodeStreamVByteDeltas(const uint32_t* values, size_t count, uint32_t base, uint8_t* out);
+
+// Decoders return the number of bytes consumed. They pick the SSSE3 version
+// at runtime when the CPU supports it and the scalar one otherwise.
+size_t DecodeStreamVByte(const uint8_t* in, size_t count, uint32_t* values);
+size_t DecodeStreamVByteDeltas(const uint8_t* in, size_t count, uint32_t base, uint32_t* values);
+
+// Concrete implementations, exposed for benchmarks
+size_t DecodeStreamVByteScalar(const uint8_t* in, size_t count, uint32_t* values);
+size_t DecodeStreamVByteDeltasScalar(const uint8_t* in, size_t count, uint32_t base, uint32_t* values);
+bool IsStreamVByteSimdSupported();
+size_t DecodeStreamVByteSimd(const uint8_t* in, size_t count, uint32_t* values);
+size_t DecodeStreamVByteDeltasSimd(const uint8_t* in, size_t count, uint32_t base, uint32_t* values);
@@ -0,0 +1,34 @@
+#include "string_arena.h"
+#include <algorithm>
+
+StringArena::StringArena(size_t chunk_size)
+    : chunk_size_(chunk_size)
+{
+}
+
+std::string_view StringArena::Store(std::string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+    if (text.size() > free_size_) {
+        // A string longer than a chunk gets a chunk of its own and keeps the
+        // current one open for the strings that follow
+        const size_t size = std::max(chunk_size_, text.size());
+        chunks_.push_back(std::make_unique<char[]>(size));
+        allocated_bytes_ += size;
+        if (size == chunk_size_) {
+            free_begin_ = chunks_.back().get();
+            free_size_ = size;
+        } else {
+            std::copy(text.begin(), text.end(), chunks_.back().get());
+            used_bytes_ += text.size();
+            return { chunks_.back().get(), text.size() };
+        }
+    }
+    char* stored = free_begin_;
+    std::copy(text.begin(), text.end(), stored);
+    free_begin_ += text.size();
+    free_size_ -= text.size();
+    used_bytes_ += text.size();
+    return { stored, text.size() };
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only string storage. Strings are copied into large chunks, so storing
+// many small strings costs one allocation per chunk instead of one per string.
+// Views returned by Store stay valid for the arena's whole lifetime.
+class StringArena {
+public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    explicit StringArena(size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    std::string_view Store(std::string_view text);
+
+    // Bytes taken from the allocator
+    size_t GetAllocatedBytes() const {
+        return allocated_bytes_;
+    }
+
+    // Bytes occupied by stored strings
+    size_t GetUsedBytes() const {
+        return used_bytes_;
+    }
+
+private:
+    size_t chunk_size_;
+    std::vector<std::unique_ptr<char[]>> chunks_;
+    char* free_begin_ = nullptr;
+    size_t free_size_ = 0;
+    size_t allocated_bytes_ = 0;
+    size_t used_bytes_ = 0;
+};
@@ -1,7 +1,13 @@
 #include "string_processing.h"
+#include <algorithm>
+#include <cstring>
 #include <vector>
 #include <string>
 #include <sstream>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SPLIT_WORDS_X86 1
+#include <immintrin.h>
+#endif
 
 std::vector<std::string> SplitIntoWords(const std::string& text) {
     std::vector<std::string> words;
@@ -24,4 +30,200 @@ std::vector<std::string_view> SplitIntoWordsView(std::string_view str) {
     }
 
     return result;
-}
\ No newline at end of file
+}
+namespace {
+
+uint64_t HashWord(std::string_view word) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const char c : word) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t GetSizeBit(size_t size) {
+    return uint64_t{1} << std::min<size_t>(size, 63);
+}
+
+} // namespace
+
+StopWordSet::StopWordSet(const std::set<std::string, std::less<>>& words) {
+    size_t slot_count = 1;
+    while (slot_count < words.size() * 2) {
+        slot_count *= 2;
+    }
+    slots_.resize(slot_count);
+    for (const std::string& word : words) {
+        if (word.empty()) {
+            continue;
+        }
+        const uint64_t hash = HashWord(word);
+        size_t slot = hash & (slot_count - 1);
+        while (slots_[slot].size != 0) {
+            slot = (slot + 1) & (slot_count - 1);
+        }
+        slots_[slot] = { hash, static_cast<uint32_t>(chars_.size()), static_cast<uint32_t>(word.size()) };
+        chars_ += word;
+        sizes_ |= GetSizeBit(word.size());
+    }
+}
+
+bool StopWordSet::Contains(std::string_view word) const {
+    if ((sizes_ & GetSizeBit(word.size())) == 0) {
+        return false;
+    }
+    const uint64_t hash = HashWord(word);
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = hash & mask; slots_[slot].size != 0; slot = (slot + 1) & mask) {
+        const Slot& candidate = slots_[slot];
+        if (candidate.hash == hash && candidate.size == word.size()
+            && std::memcmp(chars_.data() + candidate.offset, word.data(), word.size()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+// Scanners find the spaces and control characters of BLOCK_SIZE bytes at a
+// time. Scan sets bit i of `spaces` if byte i is a space and returns false on
+// control characters; an unsigned byte <= 31 is one, so UTF-8 bytes of 128
+// and up pass.
+
+#ifdef SPLIT_WORDS_X86
+struct Avx2Scanner {
+    static constexpr size_t BLOCK_SIZE = 32;
+
+    __attribute__((target("avx2")))
+    static bool Scan(const char* block, uint32_t& spaces) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+        const __m256i controls = _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, _mm256_set1_epi8(31)), bytes);
+        if (_mm256_movemask_epi8(controls) != 0) {
+            return false;
+        }
+        spaces = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '))));
+        return true;
+    }
+};
+#endif
+
+// What every CPU the build targets has
+#if defined(__SSE2__)
+struct BaselineScanner {
+    static constexpr size_t BLOCK_SIZE = 16;
+
+    static bool Scan(const char* block, uint32_t& spaces) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+        const __m128i controls = _mm_cmpeq_epi8(_mm_min_epu8(bytes, _mm_set1_epi8(31)), bytes);
+        if (_mm_movemask_epi8(controls) != 0) {
+            return false;
+        }
+        spaces = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '))));
+        return true;
+    }
+};
+#else
+struct BaselineScanner {
+    static constexpr size_t BLOCK_SIZE = 8;
+
+    static bool Scan(const char* block, uint32_t& spaces) {
+        spaces = 0;
+        for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+            const uint8_t c = static_cast<uint8_t>(block[i]);
+            if (c < ' ') {
+                return false;
+            }
+            spaces |= uint32_t{c == ' '} << i;
+        }
+        return true;
+    }
+};
+#endif
+
+// Always inlined, so that the AVX2 caller compiles it and its scanner with AVX2
+template <typename Scanner>
+inline __attribute__((always_inline))
+bool SplitBlocks(std::string_view text, const StopWordSet* skipped, std::vector<std::string_view>& words) {
+    constexpr size_t BLOCK_SIZE = Scanner::BLOCK_SIZE;
+    constexpr uint32_t FULL_BLOCK = static_cast<uint32_t>((uint64_t{1} << BLOCK_SIZE) - 1);
+
+    const auto add_word = [&](size_t begin, size_t end) {
+        const std::string_view word = text.substr(begin, end - begin);
+        if (skipped == nullptr || !skipped->Contains(word)) {
+            words.push_back(word);
+        }
+    };
+
+    size_t word_begin = 0;
+    bool in_word = false;
+    // Handles the block at `position` given which of its bytes are spaces
+    const auto split_block = [&](size_t position, uint32_t spaces) {
+        const uint32_t letters = ~spaces & FULL_BLOCK;
+        // Bits where a word starts or ends; the previous block's last byte decides bit 0
+        uint32_t changes = (letters ^ ((letters << 1) | uint32_t{in_word})) & FULL_BLOCK;
+        while (changes != 0) {
+            const size_t offset = position + __builtin_ctz(changes);
+            if (in_word) {
+                add_word(word_begin, offset);
+            } else {
+                word_begin = offset;
+            }
+            in_word = !in_word;
+            changes &= changes - 1;
+        }
+    };
+
+    size_t position = 0;
+    uint32_t spaces;
+    for (; position + BLOCK_SIZE <= text.size(); position += BLOCK_SIZE) {
+        if (!Scanner::Scan(text.data() + position, spaces)) {
+            return false;
+        }
+        split_block(position, spaces);
+    }
+    if (position < text.size()) {
+        // Padding with spaces ends a word that runs to the end of the text
+        char block[BLOCK_SIZE];
+        std::memset(block, ' ', BLOCK_SIZE);
+        std::memcpy(block, text.data() + position, text.size() - position);
+        if (!Scanner::Scan(block, spaces)) {
+            return false;
+        }
+        split_block(position, spaces);
+    } else if (in_word) {
+        add_word(word_begin, text.size());
+    }
+    return true;
+}
+
+using SplitFunction = bool (*)(std::string_view, const StopWordSet*, std::vector<std::string_view>&);
+
+#ifdef SPLIT_WORDS_X86
+__attribute__((target("avx2")))
+bool SplitAvx2(std::string_view text, const StopWordSet* skipped, std::vector<std::string_view>& words) {
+    return SplitBlocks<Avx2Scanner>(text, skipped, words);
+}
+#endif
+
+bool SplitBaseline(std::string_view text, const StopWordSet* skipped, std::vector<std::string_view>& words) {
+    return SplitBlocks<BaselineScanner>(text, skipped, words);
+}
+
+// AVX2 is checked for at run time, so one build uses it wherever the CPU has it
+SplitFunction ChooseSplitFunction() {
+#ifdef SPLIT_WORDS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SplitAvx2;
+    }
+#endif
+    return SplitBaseline;
+}
+
+} // namespace
+
+bool SplitIntoValidWords(std::string_view text, const StopWordSet* skipped, std::vector<std::string_view>& words) {
+    static const SplitFunction split = ChooseSplitFunction();
+    return split(text, skipped, words);
+}
@@ -1,14 +1,47 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <string_view>
 #include <set>
 
+// Open-addressing hash set of words. Lookups of words with a length no
+// stored word has skip hashing, which is the common case for stop words.
+class StopWordSet {
+public:
+    StopWordSet() = default;
+    explicit StopWordSet(const std::set<std::string, std::less<>>& words);
+
+    bool Contains(std::string_view word) const;
+
+private:
+    struct Slot {
+        uint64_t hash;
+        uint32_t offset;
+        // Zero for free slots; stored words are never empty
+        uint32_t size;
+    };
+
+    // The words one after another; slots refer to them by offset, so copies stay valid
+    std::string chars_;
+    // Size is a power of two, at most half full
+    std::vector<Slot> slots_;
+    // Bit n is set if a word of n bytes is stored; longer words use bit 63
+    uint64_t sizes_ = 0;
+};
+
 std::vector<std::string> SplitIntoWords(const std::string& text);
 
 std::vector<std::string_view> SplitIntoWordsView(std::string_view str);
 
+// Appends the space-separated words of `text` that are not in `skipped`
+// (nullptr skips none) to `words`. Word boundaries and control characters
+// (codes below 32) are found in the same pass: 32 bytes at a time with AVX2,
+// if the CPU running the program has it, else 16 with SSE2, else 8. Returns
+// false if the text contains a control character; `words` is then incomplete.
+bool SplitIntoValidWords(std::string_view text, const StopWordSet* skipped, std::vector<std::string_view>& words);
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
@@ -0,0 +1,56 @@
+#include "term_dictionary.h"
+
+TermDictionary::TermId TermDictionary::Find(std::string_view term) const {
+    const auto it = term_to_id_.find(term);
+    return it == term_to_id_.end() ? NO_TERM : it->second;
+}
+
+TermDictionary::TermId TermDictionary::Insert(std::string_view term) {
+    const auto it = term_to_id_.find(term);
+    if (it != term_to_id_.end()) {
+        return it->second;
+    }
+    const TermId term_id = static_cast<TermId>(terms_.size());
+    const std::string_view stored = arena_.Store(term);
+    terms_.push_back(stored);
+    term_to_id_.emplace(stored, term_id);
+    return term_id;
+}
+
+std::string_view TermDictionary::GetTerm(TermId term_id) const {
+    return terms_.at(term_id);
+}
+
+void TermDictionary::Save(SnapshotWriter& writer) const {
+    std::vector<uint64_t> offsets = {0};
+    offsets.reserve(terms_.size() + 1);
+    for (const std::string_view term : terms_) {
+        offsets.push_back(offsets.back() + term.size());
+    }
+    writer.WriteArray(offsets.data(), offsets.size());
+    writer.Write(offsets.back());
+    for (const std::string_view term : terms_) {
+        writer.WriteRaw(term.data(), term.size());
+    }
+    writer.Align();
+}
+
+TermDictionary TermDictionary::Load(SnapshotReader& reader) {
+    const auto offsets = reader.ReadArray<uint64_t>();
+    const std::string_view texts = reader.ReadString();
+    if (offsets.size() == 0 || offsets.begin()[offsets.size() - 1] != texts.size()) {
+        SnapshotReader::ThrowCorrupt();
+    }
+    TermDictionary dictionary;
+    dictionary.terms_.reserve(offsets.size() - 1);
+    dictionary.term_to_id_.reserve(offsets.size() - 1);
+    for (const uint64_t* offset = offsets.begin(); offset + 1 != offsets.end(); ++offset) {
+        if (offset[0] > offset[1]) {
+            SnapshotReader::ThrowCorrupt();
+        }
+        const std::string_view term = texts.substr(offset[0], offset[1] - offset[0]);
+        dictionary.term_to_id_.emplace(term, static_cast<TermId>(dictionary.terms_.size()));
+        dictionary.terms_.push_back(term);
+    }
+    return dictionary;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "snapshot.h"
+#include "string_arena.h"
+
+// Maps every indexed term to a dense id. Term texts are stored once in an
+// arena and looked up by string_view, so Find never allocates.
+class TermDictionary {
+public:
+    using TermId = uint32_t;
+    static constexpr TermId NO_TERM = UINT32_MAX;
+
+    TermId Find(std::string_view term) const;
+    TermId Insert(std::string_view term);
+
+    std::string_view GetTerm(TermId term_id) const;
+
+    size_t size() const {
+        return terms_.size();
+    }
+
+    const StringArena& GetArena() const {
+        return arena_;
+    }
+
+    void Save(SnapshotWriter& writer) const;
+    // Term texts stay in the snapshot's mapping instead of the arena
+    static TermDictionary Load(SnapshotReader& reader);
+
+private:
+    StringArena arena_;
+    // Views into arena_, indexed by term id
+    std::vector<std::string_view> terms_;
+    std::unordered_map<std::string_view, TermId> term_to_id_;
+};
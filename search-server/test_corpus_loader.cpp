@@ -0,0 +1,117 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "corpus_generator.h"
+#include "corpus_loader.h"
+#include "search_server.h"
+#include "test_example_functions.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+// More than a few of the 1 MiB slices LoadCorpus parses on separate threads
+const size_t CORPUS_FILE_SIZE = 4 << 20;
+
+// Rejected lines repeat with this period, so every slice has each kind
+const size_t REJECTION_PERIOD = 499;
+
+std::string GetStatusName(DocumentStatus status) {
+    switch (status) {
+    case DocumentStatus::ACTUAL:
+        return "ACTUAL"s;
+    case DocumentStatus::IRRELEVANT:
+        return "IRRELEVANT"s;
+    case DocumentStatus::BANNED:
+        return "BANNED"s;
+    case DocumentStatus::REMOVED:
+        return "REMOVED"s;
+    }
+    return {};
+}
+
+std::string JoinRatings(const std::vector<int>& ratings) {
+    std::string text;
+    for (const int rating : ratings) {
+        text += (text.empty() ? ""s : " "s) + std::to_string(rating);
+    }
+    return text;
+}
+
+} // namespace
+
+void TestLoadCorpus() {
+    CorpusGeneratorOptions options;
+    options.seed = 16;
+    options.vocabulary_size = 5000;
+    CorpusGenerator generator(options);
+    SearchServer expected(generator.GetStopWords());
+    std::vector<int> document_ids;
+    std::vector<RejectedDocument> expected_rejected;
+
+    std::string corpus;
+    size_t line_number = 0;
+    const auto add_line = [&](const std::string& line) {
+        ++line_number;
+        // Windows line breaks on every third line
+        corpus += line + (line_number % 3 == 0 ? "\r\n"s : "\n"s);
+    };
+    for (int first_id = 0; corpus.size() < CORPUS_FILE_SIZE; first_id += 10000) {
+        for (const GeneratedDocument& document : generator.GenerateDocuments(10000, first_id)) {
+            const std::string id = std::to_string(document.id);
+            const std::string fields = GetStatusName(document.status) + "\t"s + JoinRatings(document.ratings) + "\t"s + document.text;
+            switch ((line_number + 1) % REJECTION_PERIOD) {
+            case 7:
+                add_line("x"s + id + "\t"s + fields);
+                expected_rejected.push_back({ line_number, -1, "Invalid document_id"s });
+                continue;
+            case 100:
+                add_line(id + "\tFRESH\t1\t"s + document.text);
+                expected_rejected.push_back({ line_number, document.id, "Invalid status"s });
+                continue;
+            case 200:
+                add_line(id + "\tACTUAL\t1 2x\t"s + document.text);
+                expected_rejected.push_back({ line_number, document.id, "Invalid ratings"s });
+                continue;
+            case 300:
+                add_line(id + "\tACTUAL\t1 2"s);
+                expected_rejected.push_back({ line_number, document.id, "Missing fields"s });
+                continue;
+            case 400:
+                // Parses, but AddDocuments refuses the id
+                add_line("-"s + id + "\t"s + fields);
+                expected_rejected.push_back({ line_number, -document.id, {} });
+                continue;
+            }
+            add_line(id + "\t"s + fields);
+            expected.AddDocument(document.id, document.text, document.status, document.ratings);
+            document_ids.push_back(document.id);
+            if (line_number % 101 == 0) {
+                add_line(""s);
+            }
+        }
+    }
+    // The last line has no line break
+    corpus.pop_back();
+
+    TemporaryDirectory directory;
+    const std::string path = directory.GetPath("corpus.tsv"s);
+    std::ofstream(path, std::ios::binary) << corpus;
+    SearchServer loaded(generator.GetStopWords());
+    const CorpusLoadResult result = LoadCorpus(loaded, path);
+
+    Check(result.byte_count == corpus.size(), "LoadCorpus counts other bytes"s);
+    Check(result.document_count == document_ids.size(), "LoadCorpus adds "s + std::to_string(result.document_count)
+          + " documents instead of "s + std::to_string(document_ids.size()));
+    Check(result.rejected.size() == expected_rejected.size(), "LoadCorpus rejects "s + std::to_string(result.rejected.size())
+          + " lines instead of "s + std::to_string(expected_rejected.size()));
+    for (size_t i = 0; i < expected_rejected.size(); ++i) {
+        const RejectedDocument& rejected = result.rejected[i];
+        const std::string context = "line "s + std::to_string(expected_rejected[i].index);
+        Check(rejected.index == expected_rejected[i].index, context + ": rejected line "s + std::to_string(rejected.index));
+        Check(rejected.document_id == expected_rejected[i].document_id, context + ": rejected id "s + std::to_string(rejected.document_id));
+        Check(expected_rejected[i].reason.empty() || rejected.reason == expected_rejected[i].reason, context + ": "s + rejected.reason);
+    }
+    CheckSameIndex(loaded, expected, document_ids, generator.GenerateQueries(100), "loaded corpus"s);
+}
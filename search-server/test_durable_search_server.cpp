@@ -0,0 +1,179 @@
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "durable_search_server.h"
+#include "test_example_functions.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+const std::string STOP_WORDS = "and in on"s;
+
+struct ModelDocument {
+    std::string text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+// What the durable server must hold after a restart
+class Model {
+public:
+    void Add(int document_id, const std::string& text, DocumentStatus status, const std::vector<int>& ratings) {
+        documents_[document_id] = { text, status, ratings };
+    }
+
+    void Remove(int document_id) {
+        documents_.erase(document_id);
+    }
+
+    void Check(const DurableSearchServer& server, const std::string& context) const {
+        SearchServer expected(STOP_WORDS);
+        std::vector<int> document_ids;
+        for (const auto& [document_id, document] : documents_) {
+            expected.AddDocument(document_id, document.text, document.status, document.ratings);
+            document_ids.push_back(document_id);
+        }
+        CheckSameIndex(server.GetServer(), expected, document_ids,
+                       { "cat"s, "dog"s, "cat dog -grey"s, "grey parrot in cage"s, "fluffy -cat"s, "w3 w7 w11"s }, context);
+    }
+
+private:
+    std::map<int, ModelDocument> documents_;
+};
+
+std::string MakeText(int document_id) {
+    static const std::string ANIMALS[] = { "cat"s, "dog"s, "parrot"s, "hamster"s };
+    static const std::string TRAITS[] = { "grey"s, "fluffy"s, "loud"s };
+    return ANIMALS[document_id % 4] + " "s + TRAITS[document_id % 3] + " in cage w"s + std::to_string(document_id % 13);
+}
+
+DocumentStatus MakeStatus(int document_id) {
+    return document_id % 7 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+}
+
+void FlipByte(const std::string& path, size_t offset) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(offset);
+    char byte = 0;
+    file.get(byte);
+    file.seekp(offset);
+    file.put(static_cast<char>(byte ^ 0x20));
+}
+
+} // namespace
+
+void TestDurableSearchServer() {
+    TemporaryDirectory directory;
+    const std::string snapshot_path = directory.GetPath("index.snapshot"s);
+    const std::string log_path = directory.GetPath("index.log"s);
+    Model model;
+
+    {
+        DurableSearchServer server(STOP_WORDS, snapshot_path, log_path);
+        Check(server.GetReplayedRecordCount() == 0, "a new log has records"s);
+        for (int id = 0; id < 40; ++id) {
+            server.AddDocument(id, MakeText(id), MakeStatus(id), { id, 1 });
+            model.Add(id, MakeText(id), MakeStatus(id), { id, 1 });
+        }
+        bool thrown = false;
+        try {
+            server.AddDocument(5, "another text"s, DocumentStatus::ACTUAL, { 1 });
+        } catch (const std::invalid_argument&) {
+            thrown = true;
+        }
+        Check(thrown, "a duplicate id is accepted"s);
+        for (int id = 0; id < 40; id += 3) {
+            server.RemoveDocument(id);
+            model.Remove(id);
+        }
+        // Neither is logged
+        server.RemoveDocument(3);
+        server.RemoveDocument(1000);
+        server.Checkpoint();
+        model.Check(server, "before the restart"s);
+
+        // 10 records after the checkpoint
+        for (int id = 40; id < 45; ++id) {
+            server.AddDocument(id, MakeText(id), MakeStatus(id), { -id });
+            model.Add(id, MakeText(id), MakeStatus(id), { -id });
+        }
+        const std::string text = "cat dog"s;
+        const std::string invalid_text = "cat\x01"s;
+        const auto rejected = server.AddDocuments({
+            { 45, text, DocumentStatus::IRRELEVANT, { 2 } },
+            { 41, text, DocumentStatus::ACTUAL, { 2 } },
+            { 46, invalid_text, DocumentStatus::ACTUAL, { 2 } },
+            { 0, text, DocumentStatus::ACTUAL, { 7 } },
+        });
+        model.Add(45, text, DocumentStatus::IRRELEVANT, { 2 });
+        model.Add(0, text, DocumentStatus::ACTUAL, { 7 });
+        Check(rejected.size() == 2 && rejected[0].index == 1 && rejected[1].index == 2, "wrong documents rejected"s);
+        server.RemoveDocuments({ 1, 1, 2000, 42, 3 });
+        model.Remove(1);
+        model.Remove(42);
+        server.RemoveDocument(43);
+        model.Remove(43);
+    }
+
+    {
+        DurableSearchServer server(STOP_WORDS, snapshot_path, log_path);
+        Check(server.GetReplayedRecordCount() == 10, "the log holds other records than those after the checkpoint"s);
+        model.Check(server, "after the restart"s);
+    }
+
+    // A crash in the middle of the last record, which removed document 43
+    std::filesystem::resize_file(log_path, std::filesystem::file_size(log_path) - 3);
+    model.Add(43, MakeText(43), MakeStatus(43), { -43 });
+    {
+        DurableSearchServer server(STOP_WORDS, snapshot_path, log_path);
+        Check(server.GetReplayedRecordCount() == 9, "a torn record is replayed"s);
+        model.Check(server, "after a torn record"s);
+        // Goes after the cut, not after the torn bytes
+        server.AddDocument(50, "parrot on cage"s, DocumentStatus::ACTUAL, { 3 });
+        model.Add(50, "parrot on cage"s, DocumentStatus::ACTUAL, { 3 });
+    }
+
+    {
+        DurableSearchServer server(STOP_WORDS, snapshot_path, log_path);
+        Check(server.GetReplayedRecordCount() == 10, "a record after a torn one is lost"s);
+        model.Check(server, "after writing past a torn record"s);
+        server.Checkpoint();
+    }
+
+    {
+        DurableSearchServer server(STOP_WORDS, snapshot_path, log_path);
+        Check(server.GetReplayedRecordCount() == 0, "the checkpoint leaves records in the log"s);
+        model.Check(server, "after the second checkpoint"s);
+        for (int id = 60; id < 63; ++id) {
+            server.AddDocument(id, MakeText(id), MakeStatus(id), { 1 });
+            model.Add(id, MakeText(id), MakeStatus(id), { 1 });
+        }
+    }
+
+    // Damage in the first record, after the 8-byte magic and 8-byte record
+    // header, with intact records after it: nothing may be cut off
+    const auto log_size = std::filesystem::file_size(log_path);
+    FlipByte(log_path, 20);
+    bool thrown = false;
+    try {
+        DurableSearchServer server(STOP_WORDS, snapshot_path, log_path);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    Check(thrown, "a log damaged in the middle is replayed"s);
+    Check(std::filesystem::file_size(log_path) == log_size, "a log damaged in the middle is cut"s);
+    FlipByte(log_path, 20);
+
+    // A damaged last record is torn
+    FlipByte(log_path, log_size - 2);
+    model.Remove(62);
+    {
+        DurableSearchServer server(STOP_WORDS, snapshot_path, log_path);
+        Check(server.GetReplayedRecordCount() == 2, "a damaged last record is replayed"s);
+        model.Check(server, "after a damaged last record"s);
+    }
+}
@@ -0,0 +1,135 @@
+#include "test_example_functions.h"
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <execution>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "concurrent_search_server.h"
+
+using namespace std::string_literals;
+
+void Check(bool condition, const std::string& message) {
+    if (!condition) {
+        std::cerr << "Test failed: "s << message << std::endl;
+        std::abort();
+    }
+}
+
+TemporaryDirectory::TemporaryDirectory() {
+    const auto base = std::filesystem::temp_directory_path();
+    for (unsigned attempt = std::random_device{}();; ++attempt) {
+        const auto path = base / ("search_server_test_"s + std::to_string(attempt));
+        if (std::filesystem::create_directory(path)) {
+            path_ = path.string();
+            return;
+        }
+    }
+}
+
+TemporaryDirectory::~TemporaryDirectory() {
+    std::error_code error;
+    std::filesystem::remove_all(path_, error);
+}
+
+std::string TemporaryDirectory::GetPath(const std::string& name) const {
+    return (std::filesystem::path(path_) / name).string();
+}
+
+void CheckSameDocuments(const std::vector<Document>& actual, const std::vector<Document>& expected, const std::string& context) {
+    bool same = actual.size() == expected.size();
+    for (size_t i = 0; same && i < actual.size(); ++i) {
+        same = actual[i].id == expected[i].id
+            && actual[i].rating == expected[i].rating
+            && std::abs(actual[i].relevance - expected[i].relevance) < 1e-12;
+    }
+    Check(same, context + ": other documents found"s);
+}
+
+void CheckSameIndex(const SearchServer& actual, const SearchServer& expected, const std::vector<int>& document_ids,
+                    const std::vector<std::string>& queries, const std::string& context) {
+    Check(actual.GetDocumentCount() == expected.GetDocumentCount(), context + ": wrong document count"s);
+    Check(actual.GetDocumentCount() == static_cast<int>(document_ids.size()), context + ": wrong document count"s);
+    for (const int document_id : document_ids) {
+        const std::string id_context = context + ": document "s + std::to_string(document_id);
+        Check(actual.HasDocument(document_id), id_context + " is missing"s);
+        Check(actual.GetDocumentText(document_id) == expected.GetDocumentText(document_id), id_context + " has another text"s);
+        Check(actual.GetWordFrequencies(document_id) == expected.GetWordFrequencies(document_id), id_context + " has other words"s);
+    }
+    for (const std::string& query : queries) {
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED, DocumentStatus::REMOVED }) {
+            CheckSameDocuments(actual.FindTopDocuments(query, status), expected.FindTopDocuments(query, status),
+                               context + ": \""s + query + "\""s);
+        }
+    }
+}
+
+namespace {
+
+std::string MakeText(int document_id) {
+    return "common w"s + std::to_string(document_id % 20) + (document_id % 2 == 0 ? " even"s : " odd"s);
+}
+
+} // namespace
+
+void TestConcurrentSearchServer() {
+    const int document_count = 1000;
+    const int reader_count = 4;
+    ConcurrentSearchServer server("and with"s);
+    std::atomic<bool> writing{true};
+
+    std::thread writer([&] {
+        for (int id = 0; id < document_count; ++id) {
+            server.AddDocument(id, MakeText(id), DocumentStatus::ACTUAL, {id % 5});
+            if (id >= 10 && id % 3 == 0) {
+                server.RemoveDocument(id - 10);
+            }
+            if (id % 500 == 0) {
+                server.SetRetrievalMode(id % 1000 == 0 ? RetrievalMode::MAX_SCORE : RetrievalMode::EXHAUSTIVE);
+            }
+        }
+        server.Compact();
+        writing = false;
+    });
+
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < reader_count; ++reader) {
+        readers.emplace_back([&server, &writing] {
+            uint64_t last_version = 0;
+            while (writing) {
+                const uint64_t version = server.GetVersion();
+                Check(version >= last_version, "version went back"s);
+                last_version = version;
+
+                for (const Document& document : server.FindTopDocuments(std::execution::par, "common w3 -even"s)) {
+                    Check(document.id % 2 == 1, "minus word ignored"s);
+                }
+
+                // Every document found must still be there for MatchDocument on the same version
+                server.Read([](const SearchServer& snapshot) {
+                    for (const Document& document : snapshot.FindTopDocuments("w7"s)) {
+                        const auto [words, status] = snapshot.MatchDocument("w7 odd"s, document.id);
+                        Check(words.size() == 2 && words[0] == "odd"s && words[1] == "w7"s, "document changed within a read"s);
+                        Check(snapshot.GetDocumentText(document.id) == MakeText(document.id), "wrong document text"s);
+                    }
+                });
+            }
+        });
+    }
+
+    writer.join();
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+
+    int expected_count = 0;
+    for (int id = 0; id < document_count; ++id) {
+        const bool removed = id + 10 < document_count && (id + 10) % 3 == 0;
+        expected_count += removed ? 0 : 1;
+    }
+    Check(server.GetDocumentCount() == expected_count, "wrong document count"s);
+}
@@ -1 +1,93 @@
-#pragma once
\ No newline at end of file
+#pragma once 
+
+#include <string>
+#include <vector>
+#include "search_server.h"
+
+// Aborts the test program with the message unless the condition holds
+void Check(bool condition, const std::string& message);
+
+// A new directory under the system temporary directory, removed with
+// everything in it on destruction
+class TemporaryDirectory {
+public:
+    TemporaryDirectory();
+    ~TemporaryDirectory();
+
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+    TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+    std::string GetPath(const std::string& name) const;
+
+private:
+    std::string path_;
+};
+
+// Queries ConcurrentSearchServer from several threads while another thread adds
+// and removes documents. Build with -fsanitize=thread (the SEARCH_SERVER_TSAN
+// CMake option) to check for data races; inconsistent results abort the program.
+void TestConcurrentSearchServer();
+
+// Checks that both lists hold the same documents in the same order
+void CheckSameDocuments(const std::vector<Document>& actual, const std::vector<Document>& expected, const std::string& context);
+
+// Checks that both servers hold exactly the listed documents, with the same
+// texts and words, and answer the queries alike under every document status
+void CheckSameIndex(const SearchServer& actual, const SearchServer& expected, const std::vector<int>& document_ids,
+                    const std::vector<std::string>& queries, const std::string& context);
+
+// Restarts DurableSearchServer from its snapshot and log, including after a
+// checkpoint and with a torn last log record, and refuses a log damaged
+// before its end
+void TestDurableSearchServer();
+
+// Compares MaxScore with exhaustive scoring on random queries with minus
+// words, status and predicate filters, over sealed segments and the write segment
+void TestMaxScore();
+
+// Compares FindTopDocumentsBatch with FindTopDocuments for each query, with
+// and without minus words, over more queries than one batch group holds
+void TestFindTopDocumentsBatch();
+
+// Saves and loads a snapshot with live, removed and purged documents, sealed
+// segments, the write segment and a pending merge, and checks that truncated
+// and corrupted files are rejected
+void TestSnapshot();
+
+// Checks cached query results against an uncached server while corpus
+// statistics are swapped and documents change
+void TestResultCache();
+
+// Compares ShardedSearchServer with one SearchServer holding every document,
+// which checks that shards take IDF from the statistics of all of them
+void TestShardedSearchServer();
+
+// Compares RemoveDuplicates with a check of every pair of documents, for
+// exact duplicates, colliding fingerprints and near-duplicate thresholds
+void TestRemoveDuplicates();
+
+// Compares QueryExecutor::Process and Submit and ProcessQueries with
+// FindTopDocuments, with batches submitted from several threads at once and
+// a batch holding an invalid query
+void TestQueryExecutor();
+
+// Compares QueryExecutor::Stream and ProcessQueriesJoined with FindTopDocuments
+// for windows from one query to more than the batch, with a throwing query,
+// a throwing sink and streams from several threads at once
+void TestQueryStream();
+
+// Loads a corpus file of several parsing slices, with Windows line breaks,
+// empty lines and lines of every kind LoadCorpus rejects, and checks the
+// documents and the line numbers of the rejected lines
+void TestLoadCorpus();
+
+// Checks latency buckets and percentiles against the sorted latencies
+void TestLatencyHistogram();
+
+// Checks RequestStatistics windows, slots reused after a ring, threads that
+// exit after recording and statistics read while threads record
+void TestRequestStatistics();
+
+// Checks that removed documents score and count alike whether they wait as
+// tombstones or are compacted, by RemoveDocument or by Compact
+void TestCompaction();
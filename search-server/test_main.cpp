@@ -0,0 +1,58 @@
+// Runs the tests named on the command line, or all of them; ctest runs each
+// one separately. A failed check aborts the program.
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include "test_example_functions.h"
+
+namespace {
+
+struct Test {
+    std::string_view name;
+    void (*function)();
+};
+
+const Test TESTS[] = {
+    { "concurrent_search_server", TestConcurrentSearchServer },
+    { "durable_search_server", TestDurableSearchServer },
+    { "max_score", TestMaxScore },
+    { "find_top_documents_batch", TestFindTopDocumentsBatch },
+    { "snapshot", TestSnapshot },
+    { "result_cache", TestResultCache },
+    { "sharded_search_server", TestShardedSearchServer },
+    { "remove_duplicates", TestRemoveDuplicates },
+    { "query_executor", TestQueryExecutor },
+    { "query_stream", TestQueryStream },
+    { "load_corpus", TestLoadCorpus },
+    { "latency_histogram", TestLatencyHistogram },
+    { "request_statistics", TestRequestStatistics },
+    { "compaction", TestCompaction },
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc == 1) {
+        for (const Test& test : TESTS) {
+            test.function();
+            std::cerr << test.name << " OK" << std::endl;
+        }
+        return 0;
+    }
+    for (int i = 1; i < argc; ++i) {
+        bool found = false;
+        for (const Test& test : TESTS) {
+            if (test.name == argv[i]) {
+                test.function();
+                std::cerr << test.name << " OK" << std::endl;
+                found = true;
+            }
+        }
+        if (!found) {
+            std::cerr << "Unknown test " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
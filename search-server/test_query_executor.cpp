@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "corpus_generator.h"
+#include "process_queries.h"
+#include "query_executor.h"
+#include "search_server.h"
+#include "test_example_functions.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+// A small vocabulary, so that the queries of a run share posting lists
+CorpusGeneratorOptions MakeCorpusOptions(uint64_t seed) {
+    CorpusGeneratorOptions options;
+    options.seed = seed;
+    options.vocabulary_size = 3000;
+    options.min_document_length = 4;
+    options.max_document_length = 12;
+    options.minus_word_ratio = 0.5;
+    return options;
+}
+
+void AddDocuments(SearchServer& server, const std::vector<GeneratedDocument>& documents) {
+    std::vector<DocumentToAdd> batch;
+    for (const GeneratedDocument& document : documents) {
+        batch.push_back({ document.id, document.text, document.status, document.ratings });
+    }
+    server.AddDocuments(batch);
+}
+
+std::vector<std::vector<Document>> FindEach(const SearchServer& server, const std::vector<std::string>& queries) {
+    std::vector<std::vector<Document>> results;
+    for (const std::string& query : queries) {
+        results.push_back(server.FindTopDocuments(query));
+    }
+    return results;
+}
+
+void CheckSameResults(const std::vector<std::vector<Document>>& actual, const std::vector<std::vector<Document>>& expected,
+                      const std::string& context) {
+    Check(actual.size() == expected.size(), context + ": another number of results"s);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        CheckSameDocuments(actual[i], expected[i], context + ", query "s + std::to_string(i));
+    }
+}
+
+template <typename Function>
+void CheckThrows(Function function, const std::string& context) {
+    bool thrown = false;
+    try {
+        function();
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    Check(thrown, context + ": an invalid query does not throw"s);
+}
+
+} // namespace
+
+void TestQueryExecutor() {
+    CorpusGenerator generator(MakeCorpusOptions(18));
+    SearchServer server(generator.GetStopWords());
+    AddDocuments(server, generator.GenerateDocuments(6000));
+    const auto queries = generator.GenerateQueries(1500);
+    const auto expected = FindEach(server, queries);
+
+    QueryExecutorOptions options;
+    options.thread_count = 4;
+    QueryExecutor executor(options);
+    options.share_postings = true;
+    QueryExecutor sharing_executor(options);
+    CheckSameResults(executor.Process(server, queries), expected, "Process"s);
+    CheckSameResults(sharing_executor.Process(server, queries), expected, "Process with shared postings"s);
+    CheckSameResults(ProcessQueries(server, queries), expected, "ProcessQueries"s);
+    CheckSameResults(ProcessQueries(executor, server, queries), expected, "ProcessQueries on an executor"s);
+    Check(executor.Process(server, {}).empty(), "an empty batch has results"s);
+
+    // Overlapping batches from several threads, each of its own queries
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&, thread] {
+            QueryExecutor& used = thread % 2 == 0 ? executor : sharing_executor;
+            std::vector<std::future<std::vector<std::vector<Document>>>> futures;
+            std::vector<std::vector<std::vector<Document>>> expected_results;
+            for (size_t first = thread * 100; first < queries.size(); first += 400) {
+                const std::vector<std::string> part(queries.begin() + first, queries.begin() + std::min(first + 300, queries.size()));
+                futures.push_back(used.Submit(server, part));
+                expected_results.emplace_back(expected.begin() + first, expected.begin() + first + part.size());
+            }
+            for (size_t i = 0; i < futures.size(); ++i) {
+                CheckSameResults(futures[i].get(), expected_results[i], "Submit from thread "s + std::to_string(thread));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    // A query that throws fails its batch only
+    std::vector<std::string> invalid_queries = queries;
+    invalid_queries[777] = "cat --dog"s;
+    CheckThrows([&] { executor.Process(server, invalid_queries); }, "Process"s);
+    CheckThrows([&] { sharing_executor.Process(server, invalid_queries); }, "Process with shared postings"s);
+    CheckThrows([&] { executor.Submit(server, invalid_queries).get(); }, "Submit"s);
+    CheckSameResults(executor.Process(server, queries), expected, "Process after a failed batch"s);
+}
+
+void TestQueryStream() {
+    CorpusGenerator generator(MakeCorpusOptions(20));
+    SearchServer server(generator.GetStopWords());
+    AddDocuments(server, generator.GenerateDocuments(6000));
+    const auto queries = generator.GenerateQueries(1500);
+    const auto expected = FindEach(server, queries);
+    std::vector<Document> expected_joined;
+    for (const auto& documents : expected) {
+        expected_joined.insert(expected_joined.end(), documents.begin(), documents.end());
+    }
+
+    QueryExecutorOptions options;
+    options.thread_count = 4;
+    QueryExecutor executor(options);
+    // Returns the results the sink got, in order; the sink throws at failing_index
+    const auto stream = [&](const std::vector<std::string>& streamed, size_t window_size, size_t failing_index) {
+        std::vector<std::vector<Document>> delivered;
+        executor.Stream(server, streamed, window_size, [&](size_t query_index, std::vector<Document>&& documents) {
+            Check(query_index == delivered.size(), "Stream delivers queries out of order"s);
+            if (query_index == failing_index) {
+                throw std::runtime_error("sink failed");
+            }
+            delivered.push_back(std::move(documents));
+        });
+        return delivered;
+    };
+
+    // One query at a time, a few, runs of one per worker, and more than the batch
+    for (const size_t window_size : { size_t{1}, size_t{3}, size_t{64}, STREAM_WINDOW_SIZE, queries.size() * 2 }) {
+        CheckSameResults(stream(queries, window_size, queries.size()), expected,
+                         "Stream with window "s + std::to_string(window_size));
+    }
+    Check(stream({}, 1, 0).empty(), "an empty stream has results"s);
+
+    // The sink gets the results before a throwing query and no others
+    std::vector<std::string> invalid_queries = queries;
+    invalid_queries[777] = "cat --dog"s;
+    for (const size_t window_size : { size_t{1}, size_t{64}, STREAM_WINDOW_SIZE }) {
+        const std::string context = "Stream with window "s + std::to_string(window_size) + " and an invalid query"s;
+        std::vector<std::vector<Document>> delivered;
+        CheckThrows([&] {
+            executor.Stream(server, invalid_queries, window_size, [&](size_t, std::vector<Document>&& documents) {
+                delivered.push_back(std::move(documents));
+            });
+        }, context);
+        Check(delivered.size() <= 777, context + ": results after it are delivered"s);
+        CheckSameResults(delivered, std::vector<std::vector<Document>>(expected.begin(), expected.begin() + delivered.size()), context);
+    }
+    bool thrown = false;
+    try {
+        stream(queries, 16, 100);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    Check(thrown, "an exception of the sink is lost"s);
+    CheckSameResults(stream(queries, 16, queries.size()), expected, "Stream after failed ones"s);
+
+    // Streams from several threads share the workers
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < 3; ++thread) {
+        threads.emplace_back([&, thread] {
+            std::vector<Document> joined;
+            ProcessQueriesJoined(executor, server, queries, 1 + thread * 50, [&joined](const Document& document) {
+                joined.push_back(document);
+            });
+            CheckSameDocuments(joined, expected_joined, "ProcessQueriesJoined from thread "s + std::to_string(thread));
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    CheckSameDocuments(ProcessQueriesJoined(server, queries), expected_joined, "ProcessQueriesJoined"s);
+    std::vector<Document> joined;
+    ProcessQueriesJoined(server, queries, [&joined](const Document& document) {
+        joined.push_back(document);
+    });
+    CheckSameDocuments(joined, expected_joined, "ProcessQueriesJoined with a sink"s);
+}
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+#include "remove_duplicates.h"
+#include "search_server.h"
+#include "test_example_functions.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+struct TestDocument {
+    int id;
+    std::vector<std::string> words;
+};
+
+using WordSet = std::set<std::string>;
+
+WordSet GetWordSet(const TestDocument& document) {
+    return WordSet(document.words.begin(), document.words.end());
+}
+
+double ComputeJaccardSimilarity(const WordSet& lhs, const WordSet& rhs) {
+    std::vector<std::string> common;
+    std::set_intersection(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), std::back_inserter(common));
+    const size_t union_count = lhs.size() + rhs.size() - common.size();
+    return union_count == 0 ? 1.0 : static_cast<double>(common.size()) / union_count;
+}
+
+// What RemoveDuplicates must find, comparing every pair: first each document
+// whose word set equals that of a document with a smaller id, then, among
+// the rest in id order, each one similar enough to a document still kept
+std::vector<DuplicateDocument> FindDuplicatesByPairs(std::vector<TestDocument> documents, double min_similarity) {
+    std::sort(documents.begin(), documents.end(), [](const TestDocument& lhs, const TestDocument& rhs) {
+        return lhs.id < rhs.id;
+    });
+    std::vector<WordSet> word_sets;
+    for (const TestDocument& document : documents) {
+        word_sets.push_back(GetWordSet(document));
+    }
+
+    std::vector<DuplicateDocument> duplicates;
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const auto original = std::find_if(word_sets.begin(), word_sets.begin() + i, [&](const WordSet& words) {
+            return words == word_sets[i];
+        });
+        if (original != word_sets.begin() + i) {
+            duplicates.push_back({ documents[i].id, documents[original - word_sets.begin()].id, 1.0 });
+        } else {
+            candidates.push_back(i);
+        }
+    }
+    if (min_similarity < 1.0) {
+        std::vector<size_t> kept;
+        for (const size_t later : candidates) {
+            const auto original = std::find_if(kept.begin(), kept.end(), [&](size_t earlier) {
+                return ComputeJaccardSimilarity(word_sets[later], word_sets[earlier]) >= min_similarity;
+            });
+            if (original == kept.end()) {
+                kept.push_back(later);
+            } else {
+                duplicates.push_back({ documents[later].id, documents[*original].id,
+                                       ComputeJaccardSimilarity(word_sets[later], word_sets[*original]) });
+            }
+        }
+    }
+    std::sort(duplicates.begin(), duplicates.end(), [](const DuplicateDocument& lhs, const DuplicateDocument& rhs) {
+        return lhs.document_id < rhs.document_id;
+    });
+    return duplicates;
+}
+
+std::string JoinWords(const std::vector<std::string>& words) {
+    std::string text;
+    for (const std::string& word : words) {
+        if (!text.empty()) {
+            text += ' ';
+        }
+        text += word;
+    }
+    return text;
+}
+
+void CheckRemoveDuplicates(const std::vector<TestDocument>& documents, const RemoveDuplicatesOptions& options,
+                           const std::string& context) {
+    SearchServer server(""s);
+    for (const TestDocument& document : documents) {
+        server.AddDocument(document.id, JoinWords(document.words), DocumentStatus::ACTUAL, { 1 });
+    }
+    const auto expected = FindDuplicatesByPairs(documents, options.min_similarity);
+    const auto duplicates = RemoveDuplicates(server, options);
+
+    Check(duplicates.size() == expected.size(), context + ": "s + std::to_string(duplicates.size())
+          + " duplicates instead of "s + std::to_string(expected.size()));
+    for (size_t i = 0; i < expected.size(); ++i) {
+        Check(duplicates[i].document_id == expected[i].document_id && duplicates[i].original_id == expected[i].original_id
+              && std::abs(duplicates[i].similarity - expected[i].similarity) < 1e-12,
+              context + ": other duplicate "s + std::to_string(duplicates[i].document_id));
+        Check(!server.HasDocument(duplicates[i].document_id), context + ": a duplicate is left"s);
+    }
+    Check(server.GetDocumentCount() == static_cast<int>(documents.size() - expected.size()), context + ": wrong document count"s);
+    Check(server.GetPendingRemovalCount() == 0, context + ": duplicates wait for compaction"s);
+}
+
+} // namespace
+
+void TestRemoveDuplicates() {
+    // Raw outputs of mt19937 are the same everywhere, unlike <random> distributions
+    std::mt19937 generator(25);
+    const auto next_word = [&generator] {
+        return "w"s + std::to_string(generator() % 20000);
+    };
+    std::vector<TestDocument> documents;
+    std::vector<int> ids(600);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        ids[i] = static_cast<int>(i * 3 + generator() % 3);
+    }
+    // Copies may get smaller ids than their originals
+    for (size_t i = ids.size() - 1; i > 0; --i) {
+        std::swap(ids[i], ids[generator() % (i + 1)]);
+    }
+
+    // Unrelated documents of 20 words each
+    for (size_t i = 0; i < 300; ++i) {
+        std::vector<std::string> words;
+        while (words.size() < 20) {
+            words.push_back(next_word());
+        }
+        documents.push_back({ ids[i], words });
+    }
+    const auto pick_base = [&] {
+        return documents[generator() % 300].words;
+    };
+    // The same words in another order, one of them twice
+    for (size_t i = 300; i < 380; ++i) {
+        std::vector<std::string> words = pick_base();
+        std::reverse(words.begin(), words.end());
+        words.push_back(words[generator() % words.size()]);
+        documents.push_back({ ids[i], words });
+    }
+    // One word replaced: Jaccard similarity 19 / 21 to the original
+    for (size_t i = 380; i < 500; ++i) {
+        std::vector<std::string> words = pick_base();
+        words[generator() % words.size()] = next_word();
+        documents.push_back({ ids[i], words });
+    }
+    // Six words replaced: 14 / 26
+    for (size_t i = 500; i < 600; ++i) {
+        std::vector<std::string> words = pick_base();
+        for (size_t j = 0; j < 6; ++j) {
+            words[j * 3] = next_word();
+        }
+        documents.push_back({ ids[i], words });
+    }
+
+    RemoveDuplicatesOptions options;
+    CheckRemoveDuplicates(documents, options, "exact duplicates"s);
+    // Every document in one fingerprint group, then in eight
+    options.fingerprint_bits = 0;
+    CheckRemoveDuplicates(documents, options, "one fingerprint"s);
+    options.fingerprint_bits = 3;
+    CheckRemoveDuplicates(documents, options, "three fingerprint bits"s);
+    options.fingerprint_bits = 128;
+
+    options.min_similarity = 0.8;
+    CheckRemoveDuplicates(documents, options, "near duplicates at 0.8"s);
+    options.min_similarity = 0.9;
+    CheckRemoveDuplicates(documents, options, "near duplicates at 0.9"s);
+    options.min_similarity = 0.95;
+    CheckRemoveDuplicates(documents, options, "near duplicates at 0.95"s);
+}
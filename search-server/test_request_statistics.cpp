@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "latency_histogram.h"
+#include "request_statistics.h"
+#include "test_example_functions.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+using std::chrono::nanoseconds;
+
+// Long enough slots that a test run stays in one or two of them
+RequestStatisticsOptions MakeOptions() {
+    RequestStatisticsOptions options;
+    options.slot_duration = std::chrono::minutes(1);
+    options.slot_count = 10;
+    return options;
+}
+
+void CheckSameStats(const RequestWindowStats& actual, const RequestWindowStats& expected, const std::string& context) {
+    Check(actual.request_count == expected.request_count, context + ": "s + std::to_string(actual.request_count)
+          + " requests instead of "s + std::to_string(expected.request_count));
+    Check(actual.empty_result_count == expected.empty_result_count, context + ": other empty result count"s);
+    Check(actual.p50 == expected.p50 && actual.p95 == expected.p95 && actual.p99 == expected.p99 && actual.max == expected.max,
+          context + ": other percentiles"s);
+}
+
+RequestWindowStats MakeStats(const std::vector<nanoseconds>& latencies, uint64_t empty_result_count) {
+    LatencyHistogram histogram;
+    for (const nanoseconds latency : latencies) {
+        histogram.Add(latency);
+    }
+    RequestWindowStats stats;
+    stats.request_count = latencies.size();
+    stats.empty_result_count = empty_result_count;
+    stats.p50 = histogram.GetPercentile(0.50);
+    stats.p95 = histogram.GetPercentile(0.95);
+    stats.p99 = histogram.GetPercentile(0.99);
+    stats.max = histogram.GetMax();
+    return stats;
+}
+
+} // namespace
+
+void TestLatencyHistogram() {
+    LatencyHistogram histogram;
+    Check(histogram.GetPercentile(0.5) == nanoseconds(0) && histogram.GetMax() == nanoseconds(0), "an empty histogram has latencies"s);
+
+    // Every value lies in a bucket at most 1/32 wider than it, above the bucket before
+    std::vector<uint64_t> values;
+    for (uint64_t value = 0; value < 5000; ++value) {
+        values.push_back(value);
+    }
+    for (int exponent = 12; exponent < LATENCY_MAX_EXPONENT; ++exponent) {
+        for (const uint64_t value : { (uint64_t{1} << exponent) - 1, uint64_t{1} << exponent, (uint64_t{3} << exponent) / 2 + 1 }) {
+            values.push_back(value);
+        }
+    }
+    for (const uint64_t value : values) {
+        const size_t bucket = LatencyHistogram::GetBucket(nanoseconds(value));
+        const uint64_t limit = LatencyHistogram::GetBucketLimit(bucket).count();
+        Check(bucket < LATENCY_BUCKET_COUNT && limit >= value && limit <= value + value / 32,
+              "a bucket does not fit "s + std::to_string(value));
+        Check(bucket == 0 || static_cast<uint64_t>(LatencyHistogram::GetBucketLimit(bucket - 1).count()) < value,
+              "the bucket before "s + std::to_string(value) + " holds it"s);
+    }
+    Check(LatencyHistogram::GetBucket(nanoseconds(uint64_t{1} << LATENCY_MAX_EXPONENT)) == LATENCY_BUCKET_COUNT - 1
+          && LatencyHistogram::GetBucket(nanoseconds::max()) == LATENCY_BUCKET_COUNT - 1,
+          "long latencies go past the last bucket"s);
+    Check(LatencyHistogram::GetBucket(nanoseconds(-5)) == 0, "a negative latency goes past the first bucket"s);
+
+    // Percentiles are the bucket limits of the latency of that rank
+    std::mt19937 generator(22);
+    std::vector<nanoseconds> latencies;
+    for (size_t i = 0; i < 10001; ++i) {
+        latencies.push_back(nanoseconds(generator() >> (generator() % 32)));
+        histogram.Add(latencies.back());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    Check(histogram.GetCount() == latencies.size(), "the histogram counts other latencies"s);
+    for (const double fraction : { 0.0, 0.001, 0.5, 0.9, 0.95, 0.99, 0.999, 1.0 }) {
+        const size_t rank = std::clamp<size_t>(static_cast<size_t>(std::ceil(fraction * latencies.size())), 1, latencies.size());
+        Check(histogram.GetPercentile(fraction) == LatencyHistogram::GetBucketLimit(LatencyHistogram::GetBucket(latencies[rank - 1])),
+              "other percentile "s + std::to_string(fraction));
+    }
+    Check(histogram.GetMax() == LatencyHistogram::GetBucketLimit(LatencyHistogram::GetBucket(latencies.back())), "other maximum"s);
+}
+
+void TestRequestStatistics() {
+    using Clock = RequestStatistics::Clock;
+    const RequestStatisticsOptions options = MakeOptions();
+    RequestStatistics statistics(options);
+    CheckSameStats(statistics.GetStats(), {}, "no requests"s);
+
+    // Requests from several threads, each of which exits afterwards
+    std::vector<nanoseconds> latencies;
+    for (int i = 0; i < 1000; ++i) {
+        latencies.push_back(nanoseconds(1000 + i * 997 % 5000));
+    }
+    const auto record_concurrently = [&](Clock::time_point finish_time) {
+        std::vector<std::thread> threads;
+        for (size_t thread = 0; thread < 4; ++thread) {
+            threads.emplace_back([&, thread] {
+                for (size_t i = thread; i < latencies.size(); i += 4) {
+                    statistics.Record(finish_time, latencies[i], i % 4 == 0 ? 0 : 3);
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    };
+    const auto now = Clock::now();
+    record_concurrently(now);
+    CheckSameStats(statistics.GetStats(), MakeStats(latencies, 250), "requests of exited threads"s);
+
+    // Earlier slots are counted only by windows that reach back to them
+    for (int i = 0; i < 10; ++i) {
+        statistics.Record(now - options.slot_duration * 5, nanoseconds(1000000), 1);
+    }
+    // Two slots, in case a new one began since `now`
+    CheckSameStats(statistics.GetStats(options.slot_duration * 2), MakeStats(latencies, 250), "requests of two slots"s);
+    std::vector<nanoseconds> all_latencies = latencies;
+    all_latencies.insert(all_latencies.end(), 10, nanoseconds(1000000));
+    CheckSameStats(statistics.GetStats(options.slot_duration * 7), MakeStats(all_latencies, 250), "requests of seven slots"s);
+    CheckSameStats(statistics.GetStats(), MakeStats(all_latencies, 250), "requests of every slot"s);
+
+    // A slot one ring later starts from zero
+    RequestStatistics reused(options);
+    reused.Record(now - options.slot_duration * 10, nanoseconds(5000000), 0);
+    reused.Record(now, nanoseconds(100), 1);
+    CheckSameStats(reused.GetStats(), MakeStats({ nanoseconds(100) }, 0), "a slot reused after a ring"s);
+
+    // Statistics read while threads record never go back, nor count a request twice
+    RequestStatistics concurrent(options);
+    std::atomic<bool> stop = false;
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 20000; ++i) {
+                concurrent.Record(Clock::now(), nanoseconds(i), 1);
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        uint64_t last_count = 0;
+        while (!stop) {
+            const uint64_t count = concurrent.GetStats().request_count;
+            Check(count >= last_count && count <= 80000, "concurrent statistics count "s + std::to_string(count) + " requests"s);
+            last_count = count;
+        }
+    });
+    for (size_t thread = 0; thread < 4; ++thread) {
+        threads[thread].join();
+    }
+    stop = true;
+    threads.back().join();
+    Check(concurrent.GetStats().request_count == 80000, "concurrent requests are lost"s);
+}
@@ -0,0 +1,311 @@
+#include <execution>
+#include <filesystem>
+#include <iterator>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "corpus_generator.h"
+#include "corpus_statistics.h"
+#include "search_server.h"
+#include "string_processing.h"
+#include "test_example_functions.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+// Short documents over a small vocabulary, so that words share many documents
+CorpusGeneratorOptions MakeCorpusOptions(uint64_t seed) {
+    CorpusGeneratorOptions options;
+    options.seed = seed;
+    options.vocabulary_size = 3000;
+    options.min_document_length = 4;
+    options.max_document_length = 12;
+    options.max_query_length = 5;
+    options.minus_word_ratio = 0.5;
+    return options;
+}
+
+// Adds the documents in batches, which seals write segments as they fill up,
+// then removes every seventh one
+void FillServer(SearchServer& server, const std::vector<GeneratedDocument>& documents) {
+    const size_t batch_size = 5000;
+    for (size_t begin = 0; begin < documents.size(); begin += batch_size) {
+        std::vector<DocumentToAdd> batch;
+        for (size_t i = begin; i < documents.size() && i < begin + batch_size; ++i) {
+            batch.push_back({ documents[i].id, documents[i].text, documents[i].status, documents[i].ratings });
+        }
+        server.AddDocuments(batch);
+    }
+    for (size_t i = 0; i < documents.size(); i += 7) {
+        server.RemoveDocument(documents[i].id);
+    }
+}
+
+// Runs the query with every status and with predicates in both modes, seq and par
+void CheckMaxScoreQuery(SearchServer& server, const std::string& query) {
+    const auto find_all = [&server, &query] {
+        std::vector<std::vector<Document>> results;
+        for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED, DocumentStatus::REMOVED }) {
+            results.push_back(server.FindTopDocuments(std::execution::seq, query, status));
+            results.push_back(server.FindTopDocuments(std::execution::par, query, status));
+        }
+        const auto odd_ids = [](int document_id, DocumentStatus, int) {
+            return document_id % 2 == 1;
+        };
+        const auto positive_rating = [](int, DocumentStatus status, int rating) {
+            return rating > 0 && status != DocumentStatus::BANNED;
+        };
+        results.push_back(server.FindTopDocuments(std::execution::seq, query, odd_ids));
+        results.push_back(server.FindTopDocuments(std::execution::par, query, odd_ids));
+        results.push_back(server.FindTopDocuments(std::execution::seq, query, positive_rating));
+        results.push_back(server.FindTopDocuments(std::execution::par, query, positive_rating));
+        return results;
+    };
+
+    server.SetRetrievalMode(RetrievalMode::EXHAUSTIVE);
+    const auto expected = find_all();
+    server.SetRetrievalMode(RetrievalMode::MAX_SCORE);
+    const auto actual = find_all();
+    for (size_t i = 0; i < expected.size(); ++i) {
+        CheckSameDocuments(actual[i], expected[i], "MaxScore, search "s + std::to_string(i) + " for \""s + query + "\""s);
+    }
+}
+
+// Statistics of a made-up corpus in which every word is in one document
+class FixedStatistics : public CorpusStatistics {
+public:
+    FixedStatistics(int document_count, uint64_t version)
+        : document_count_(document_count)
+        , version_(version)
+    {
+    }
+
+    int GetDocumentCount() const override {
+        return document_count_;
+    }
+
+    int GetDocumentFreq(std::string_view) const override {
+        return 1;
+    }
+
+    uint64_t GetVersion() const override {
+        return version_;
+    }
+
+private:
+    int document_count_;
+    uint64_t version_;
+};
+
+} // namespace
+
+void TestMaxScore() {
+    CorpusGenerator generator(MakeCorpusOptions(4));
+    // Two sealed segments and a write segment
+    const auto documents = generator.GenerateDocuments(2 * WRITE_SEGMENT_SIZE + 3000);
+    SearchServer server(generator.GetStopWords());
+    FillServer(server, documents);
+
+    for (const std::string& query : generator.GenerateQueries(300)) {
+        CheckMaxScoreQuery(server, query);
+    }
+    // Deep result lists, where the threshold stays low for longer
+    server.SetMaxResultDocumentCount(100);
+    for (const std::string& query : generator.GenerateQueries(50)) {
+        CheckMaxScoreQuery(server, query);
+    }
+}
+
+void TestFindTopDocumentsBatch() {
+    CorpusGenerator generator(MakeCorpusOptions(19));
+    const auto documents = generator.GenerateDocuments(WRITE_SEGMENT_SIZE + 5000);
+    SearchServer server(generator.GetStopWords());
+    FillServer(server, documents);
+
+    // More than two groups of MAX_BATCH_QUERY_COUNT; about half have minus words
+    std::vector<std::string> queries = generator.GenerateQueries(2 * MAX_BATCH_QUERY_COUNT + 100);
+    queries.push_back(queries.front());
+    queries.push_back("unknownword -anotherunknownword"s);
+    const std::vector<std::string_view> query_views(queries.begin(), queries.end());
+    for (const DocumentStatus status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED, DocumentStatus::REMOVED }) {
+        const auto results = server.FindTopDocumentsBatch(query_views, status);
+        Check(results.size() == queries.size(), "FindTopDocumentsBatch returns another number of results"s);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            CheckSameDocuments(results[i], server.FindTopDocuments(queries[i], status),
+                               "FindTopDocumentsBatch, query "s + std::to_string(i) + " \""s + queries[i] + "\""s);
+        }
+    }
+}
+
+void TestSnapshot() {
+    CorpusGenerator generator(MakeCorpusOptions(14));
+    SearchServer server(generator.GetStopWords());
+    server.SetRetrievalMode(RetrievalMode::MAX_SCORE);
+    server.SetMaxResultDocumentCount(20);
+    std::vector<int> removed_ids;
+
+    // PURGED documents: RemoveDocuments drops their postings at once
+    FillServer(server, generator.GenerateDocuments(WRITE_SEGMENT_SIZE, 0));
+    for (int id = 1; id < static_cast<int>(WRITE_SEGMENT_SIZE); id += 11) {
+        removed_ids.push_back(id);
+    }
+    server.RemoveDocuments(removed_ids);
+    // Filling the fourth sealed segment starts a merge, which is still pending
+    // at the save since nothing installs it until the next change
+    FillServer(server, generator.GenerateDocuments(3 * WRITE_SEGMENT_SIZE + 3000, WRITE_SEGMENT_SIZE));
+    // REMOVED documents, too few for a compaction
+    for (int id = 5; id < 2000; id += 13) {
+        server.RemoveDocument(id);
+    }
+    Check(server.GetPendingRemovalCount() > 0, "no removed documents wait for compaction"s);
+
+    TemporaryDirectory directory;
+    const std::string path = directory.GetPath("index.snapshot"s);
+    server.SaveSnapshot(path);
+    SearchServer loaded = SearchServer::LoadSnapshot(path);
+
+    const auto queries = generator.GenerateQueries(100);
+    Check(loaded.GetRetrievalMode() == RetrievalMode::MAX_SCORE && loaded.GetMaxResultDocumentCount() == 20,
+          "settings are not restored"s);
+    Check(loaded.GetPendingRemovalCount() == server.GetPendingRemovalCount(), "pending removals are not restored"s);
+    CheckSameIndex(loaded, server, std::vector<int>(server.begin(), server.end()), queries, "loaded snapshot"s);
+
+    // The loaded index takes further changes like the original
+    const auto more_documents = generator.GenerateDocuments(WRITE_SEGMENT_SIZE / 2, 4 * WRITE_SEGMENT_SIZE + 3000);
+    for (SearchServer* changed : { &server, &loaded }) {
+        FillServer(*changed, more_documents);
+        changed->AddDocument(1000000, "fresh document"s, DocumentStatus::ACTUAL, { 5 });
+        changed->RemoveDocument(WRITE_SEGMENT_SIZE + 1);
+        changed->Compact();
+    }
+    CheckSameIndex(loaded, server, std::vector<int>(server.begin(), server.end()), queries, "changed snapshot"s);
+
+    const auto check_rejected = [&](const std::string& damaged_path, const std::string& damage) {
+        bool thrown = false;
+        try {
+            SearchServer::LoadSnapshot(damaged_path);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        Check(thrown, "a snapshot with "s + damage + " is loaded"s);
+    };
+    const auto file_size = std::filesystem::file_size(path);
+    const std::string truncated_path = directory.GetPath("truncated.snapshot"s);
+    std::filesystem::copy_file(path, truncated_path);
+    std::filesystem::resize_file(truncated_path, file_size - 8);
+    check_rejected(truncated_path, "its end cut off"s);
+    std::filesystem::resize_file(truncated_path, file_size / 2);
+    check_rejected(truncated_path, "its second half cut off"s);
+
+    // One flipped bit in the middle of the postings passes every structural check
+    const std::string corrupted_path = directory.GetPath("corrupted.snapshot"s);
+    std::filesystem::copy_file(path, corrupted_path);
+    {
+        std::fstream file(corrupted_path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(file_size * 3 / 4);
+        char byte = 0;
+        file.get(byte);
+        file.seekp(file_size * 3 / 4);
+        file.put(static_cast<char>(byte ^ 0x10));
+    }
+    check_rejected(corrupted_path, "a flipped bit"s);
+}
+
+void TestResultCache() {
+    CorpusGenerator generator(MakeCorpusOptions(21));
+    const auto documents = generator.GenerateDocuments(3000);
+    SearchServer cached(generator.GetStopWords());
+    SearchServer uncached(generator.GetStopWords());
+    FillServer(cached, documents);
+    FillServer(uncached, documents);
+    cached.EnableResultCache();
+    const auto queries = generator.GenerateQueries(50);
+    const auto check_queries = [&](const std::string& context) {
+        for (const std::string& query : queries) {
+            CheckSameDocuments(cached.FindTopDocuments(query), uncached.FindTopDocuments(query),
+                               "result cache, "s + context + ", \""s + query + "\""s);
+        }
+    };
+
+    // Swapping statistics must not bring back results of earlier ones, even if
+    // the new version plus the number of swaps is a result epoch seen before
+    const FixedStatistics statistics[] = { { 100, 5 }, { 1000, 4 }, { 100000, 0 } };
+    const CorpusStatistics* const swaps[] = { &statistics[0], &statistics[1], nullptr, &statistics[2], &statistics[0] };
+    check_queries("own statistics"s);
+    for (size_t i = 0; i < std::size(swaps); ++i) {
+        cached.SetCorpusStatistics(swaps[i]);
+        uncached.SetCorpusStatistics(swaps[i]);
+        check_queries("statistics swap "s + std::to_string(i));
+        check_queries("statistics swap "s + std::to_string(i) + " again"s);
+    }
+    Check(cached.GetResultCacheStats().hits > 0, "the cache is never hit"s);
+
+    cached.RemoveDocument(documents[1].id);
+    uncached.RemoveDocument(documents[1].id);
+    check_queries("after a removal"s);
+}
+
+void TestCompaction() {
+    CorpusGenerator generator(MakeCorpusOptions(9));
+    // A sealed segment and the write segment both hold removed documents
+    const auto documents = generator.GenerateDocuments(WRITE_SEGMENT_SIZE + 6000);
+    SearchServer server(generator.GetStopWords());
+    server.SetMaxResultDocumentCount(20);
+    FillServer(server, documents);
+    std::vector<bool> removed(documents.size());
+    for (size_t i = 0; i < documents.size(); i += 7) {
+        removed[i] = true;
+    }
+    const auto queries = generator.GenerateQueries(100);
+
+    // A server that never held the removed documents scores alike
+    const auto check_server = [&](const std::string& context) {
+        SearchServer expected(generator.GetStopWords());
+        expected.SetMaxResultDocumentCount(20);
+        std::vector<DocumentToAdd> batch;
+        std::vector<int> document_ids;
+        for (size_t i = 0; i < documents.size(); ++i) {
+            if (!removed[i]) {
+                batch.push_back({ documents[i].id, documents[i].text, documents[i].status, documents[i].ratings });
+                document_ids.push_back(documents[i].id);
+            }
+        }
+        expected.AddDocuments(batch);
+        CheckSameIndex(server, expected, document_ids, queries, context);
+        for (const std::string& query : queries) {
+            for (const std::string_view word : SplitIntoWordsView(query)) {
+                const std::string_view plus_word = word[0] == '-' ? word.substr(1) : word;
+                Check(server.GetDocumentFreq(plus_word) == expected.GetDocumentFreq(plus_word),
+                      context + ": other document frequency of "s + std::string(plus_word));
+            }
+        }
+    };
+    Check(server.GetPendingRemovalCount() > 0, "removed documents are compacted too early"s);
+    check_server("tombstones"s);
+
+    // Removals one by one until one of them compacts
+    bool compacted = false;
+    for (size_t i = 3; i < documents.size() && !compacted; i += 7) {
+        if (i % 2 == 0) {
+            server.RemoveDocument(std::execution::par, documents[i].id);
+        } else {
+            server.RemoveDocument(std::execution::seq, documents[i].id);
+        }
+        removed[i] = true;
+        compacted = server.GetPendingRemovalCount() == 0;
+    }
+    Check(compacted, "removals are never compacted"s);
+    check_server("compacted by RemoveDocument"s);
+
+    for (size_t i = 5; i < documents.size(); i += 70) {
+        server.RemoveDocument(documents[i].id);
+        removed[i] = true;
+    }
+    check_server("tombstones after a compaction"s);
+    server.Compact(std::execution::par);
+    Check(server.GetPendingRemovalCount() == 0, "Compact leaves removed documents"s);
+    check_server("compacted by Compact"s);
+}
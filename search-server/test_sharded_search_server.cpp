@@ -0,0 +1,87 @@
+#include <string>
+#include <vector>
+#include "corpus_generator.h"
+#include "sharded_search_server.h"
+#include "string_processing.h"
+#include "test_example_functions.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+void CheckSameQueryResults(const ShardedSearchServer& sharded, const SearchServer& server,
+                           const std::vector<std::string>& queries, const std::string& context) {
+    const auto even_ids = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    };
+    for (const std::string& query : queries) {
+        const std::string query_context = context + ", \""s + query + "\""s;
+        CheckSameDocuments(sharded.FindTopDocuments(query), server.FindTopDocuments(query), query_context);
+        CheckSameDocuments(sharded.FindTopDocuments(query, DocumentStatus::BANNED),
+                           server.FindTopDocuments(query, DocumentStatus::BANNED), query_context + ", banned"s);
+        CheckSameDocuments(sharded.FindTopDocuments(query, even_ids), server.FindTopDocuments(query, even_ids),
+                           query_context + ", even ids"s);
+        for (const std::string_view word : SplitIntoWordsView(query)) {
+            const std::string_view plus_word = word[0] == '-' ? word.substr(1) : word;
+            Check(sharded.GetDocumentFreq(plus_word) == server.GetDocumentFreq(plus_word),
+                  query_context + ": other document frequency of "s + std::string(plus_word));
+        }
+    }
+}
+
+} // namespace
+
+void TestShardedSearchServer() {
+    CorpusGeneratorOptions options;
+    options.seed = 13;
+    options.vocabulary_size = 2000;
+    options.min_document_length = 4;
+    options.max_document_length = 12;
+    options.minus_word_ratio = 0.5;
+    CorpusGenerator generator(options);
+    const auto stop_words = generator.GetStopWords();
+    ShardedSearchServer sharded(stop_words, 4);
+    SearchServer server(stop_words);
+
+    const auto documents = generator.GenerateDocuments(8000);
+    std::vector<DocumentToAdd> batch;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const GeneratedDocument& document = documents[i];
+        if (i % 5 == 0) {
+            sharded.AddDocument(document.id, document.text, document.status, document.ratings);
+            server.AddDocument(document.id, document.text, document.status, document.ratings);
+        } else {
+            batch.push_back({ document.id, document.text, document.status, document.ratings });
+        }
+    }
+    // A repeated id and an invalid text
+    batch.push_back({ documents[1].id, documents[2].text, DocumentStatus::ACTUAL, { 1 } });
+    batch.push_back({ 100000, "bad\x02word"s, DocumentStatus::ACTUAL, { 1 } });
+    const auto sharded_rejected = sharded.AddDocuments(batch);
+    const auto rejected = server.AddDocuments(batch);
+    Check(sharded_rejected.size() == rejected.size(), "other documents rejected"s);
+    for (size_t i = 0; i < rejected.size(); ++i) {
+        Check(sharded_rejected[i].index == rejected[i].index && sharded_rejected[i].document_id == rejected[i].document_id,
+              "other documents rejected"s);
+    }
+    Check(sharded.GetDocumentCount() == server.GetDocumentCount(), "other document count"s);
+
+    const auto queries = generator.GenerateQueries(500);
+    CheckSameQueryResults(sharded, server, queries, "sharded"s);
+
+    // Removals change IDF on every shard, not only on the one holding the document
+    std::vector<int> removed_ids;
+    for (size_t i = 0; i < documents.size(); i += 9) {
+        removed_ids.push_back(documents[i].id);
+    }
+    sharded.RemoveDocuments(removed_ids);
+    server.RemoveDocuments(removed_ids);
+    for (size_t i = 4; i < documents.size(); i += 31) {
+        sharded.RemoveDocument(documents[i].id);
+        server.RemoveDocument(documents[i].id);
+    }
+    sharded.SetMaxResultDocumentCount(20);
+    server.SetMaxResultDocumentCount(20);
+    Check(sharded.GetDocumentCount() == server.GetDocumentCount(), "other document count after removals"s);
+    CheckSameQueryResults(sharded, server, queries, "sharded after removals"s);
+}
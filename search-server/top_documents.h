@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "document.h"
+
+// Orders by relevance, then by rating for relevances closer than EPSILON,
+// then by id so equal documents always come out in the same order
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
+// Keeps the best `capacity` documents seen so far in a bounded heap whose
+// front is the worst of them, so a weaker candidate is rejected in O(1).
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t capacity);
+
+    void Add(const Document& document);
+
+    bool IsFull() const {
+        return heap_.size() == capacity_;
+    }
+
+    // Worst document kept so far; valid only when IsFull()
+    const Document& GetWorst() const {
+        return heap_.front();
+    }
+
+    // Returns the kept documents, most relevant first
+    std::vector<Document> Extract();
+
+private:
+    size_t capacity_;
+    std::vector<Document> heap_;
+};
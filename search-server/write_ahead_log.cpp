@@ -0,0 +1,346 @@
+#include "write_ahead_log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "snapshot.h"
+
+namespace {
+
+const char LOG_MAGIC[8] = { 'S', 'R', 'C', 'H', 'W', 'A', 'L', '1' };
+// Payload size and checksum
+const size_t RECORD_HEADER_SIZE = 8;
+
+// FNV-1a over 64-bit words, then over the last bytes, folded to 32 bits
+uint32_t ComputeChecksum(const uint8_t* bytes, size_t size) {
+    uint64_t checksum = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        checksum = (checksum ^ word) * 1099511628211ull;
+    }
+    for (; i < size; ++i) {
+        checksum = (checksum ^ bytes[i]) * 1099511628211ull;
+    }
+    return static_cast<uint32_t>(checksum ^ (checksum >> 32));
+}
+
+template <typename T>
+void PutValue(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Bounds-checked reads from one record
+class RecordReader {
+public:
+    RecordReader(const uint8_t* data, size_t size)
+        : data_(data)
+        , size_(size)
+    {
+    }
+
+    template <typename T>
+    bool Get(T& value) {
+        if (size_ - position_ < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, data_ + position_, sizeof(T));
+        position_ += sizeof(T);
+        return true;
+    }
+
+    bool GetBytes(size_t size, const uint8_t*& bytes) {
+        if (size_ - position_ < size) {
+            return false;
+        }
+        bytes = data_ + position_;
+        position_ += size;
+        return true;
+    }
+
+    bool AtEnd() const {
+        return position_ == size_;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t position_ = 0;
+};
+
+// Returns false for a damaged or incomplete record
+bool DecodeRecord(const uint8_t* data, size_t available, LogRecord& record, size_t& record_size) {
+    RecordReader header(data, available);
+    uint32_t payload_size;
+    uint32_t checksum;
+    const uint8_t* payload;
+    if (!header.Get(payload_size) || !header.Get(checksum) || !header.GetBytes(payload_size, payload)
+        || ComputeChecksum(payload, payload_size) != checksum) {
+        return false;
+    }
+    record_size = RECORD_HEADER_SIZE + payload_size;
+
+    RecordReader reader(payload, payload_size);
+    int32_t document_id;
+    if (!reader.Get(record.type) || !reader.Get(document_id)) {
+        return false;
+    }
+    record.document_id = document_id;
+    if (record.type == LogRecord::Type::REMOVE_DOCUMENT) {
+        return reader.AtEnd();
+    }
+    if (record.type != LogRecord::Type::ADD_DOCUMENT) {
+        return false;
+    }
+    int32_t status;
+    uint32_t rating_count;
+    if (!reader.Get(status) || !reader.Get(rating_count) || rating_count > payload_size / sizeof(int32_t)) {
+        return false;
+    }
+    record.status = static_cast<DocumentStatus>(status);
+    record.ratings.resize(rating_count);
+    for (int& rating : record.ratings) {
+        int32_t value;
+        if (!reader.Get(value)) {
+            return false;
+        }
+        rating = value;
+    }
+    uint32_t text_size;
+    const uint8_t* text;
+    if (!reader.Get(text_size) || !reader.GetBytes(text_size, text)) {
+        return false;
+    }
+    record.text = std::string_view(reinterpret_cast<const char*>(text), text_size);
+    return reader.AtEnd();
+}
+
+// Whether a record that fails to decode is what a crash while appending
+// leaves: one that runs past the end of the file, the last one, or one
+// followed only by zeros, as in a file extended before its data reached the
+// disk. Anything else means records after it were damaged.
+bool IsTornTail(const uint8_t* data, size_t available) {
+    RecordReader header(data, available);
+    uint32_t payload_size;
+    uint32_t checksum;
+    const uint8_t* payload;
+    if (!header.Get(payload_size) || !header.Get(checksum) || !header.GetBytes(payload_size, payload) || header.AtEnd()) {
+        return true;
+    }
+    return std::all_of(data, data + available, [](uint8_t byte) {
+        return byte == 0;
+    });
+}
+
+bool WriteAll(int descriptor, const std::string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        const ssize_t result = write(descriptor, data.data() + written, data.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+} // namespace
+
+WriteAheadLog::WriteAheadLog(const std::string& path, WriteAheadLogOptions options)
+    : path_(path)
+    , options_(options)
+{
+    descriptor_ = open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (descriptor_ < 0) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    struct stat status;
+    char magic[sizeof(LOG_MAGIC)];
+    const bool valid = fstat(descriptor_, &status) == 0
+        && (status.st_size < static_cast<off_t>(sizeof(LOG_MAGIC))
+            || (pread(descriptor_, magic, sizeof(magic), 0) == sizeof(magic) && std::memcmp(magic, LOG_MAGIC, sizeof(magic)) == 0));
+    if (!valid) {
+        close(descriptor_);
+        throw std::runtime_error(path + " is not a write-ahead log");
+    }
+    // A new log, or one whose creation was cut short
+    if (status.st_size < static_cast<off_t>(sizeof(LOG_MAGIC))) {
+        if (ftruncate(descriptor_, 0) != 0 || !WriteAll(descriptor_, std::string(LOG_MAGIC, sizeof(LOG_MAGIC)))
+            || fsync(descriptor_) != 0) {
+            close(descriptor_);
+            throw std::runtime_error("Cannot write " + path);
+        }
+    }
+    if (options_.sync_interval.count() > 0) {
+        sync_thread_ = std::thread([this] {
+            RunSyncThread();
+        });
+    }
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (sync_thread_.joinable()) {
+        {
+            std::lock_guard guard(mutex_);
+            stopping_ = true;
+        }
+        stop_requested_.notify_all();
+        sync_thread_.join();
+    }
+    try {
+        Sync();
+    } catch (const std::runtime_error&) {
+        // Nothing left to report the failure to; the records are lost either way
+    }
+    close(descriptor_);
+}
+
+size_t WriteAheadLog::Replay(const std::function<void(const std::vector<LogRecord>&)>& apply) {
+    struct stat status;
+    if (fstat(descriptor_, &status) != 0) {
+        throw std::runtime_error("Cannot read " + path_);
+    }
+    if (status.st_size <= static_cast<off_t>(sizeof(LOG_MAGIC))) {
+        return 0;
+    }
+
+    size_t record_count = 0;
+    size_t valid_size = sizeof(LOG_MAGIC);
+    {
+        const MappedFile file(path_);
+        std::vector<LogRecord> records;
+        LogRecord record;
+        size_t record_size;
+        while (DecodeRecord(file.data() + valid_size, file.size() - valid_size, record, record_size)) {
+            records.push_back(std::move(record));
+            valid_size += record_size;
+            if (records.size() == LOG_REPLAY_BATCH_SIZE) {
+                apply(records);
+                record_count += records.size();
+                records.clear();
+            }
+        }
+        if (!records.empty()) {
+            apply(records);
+            record_count += records.size();
+        }
+        // Cutting the log here would drop committed records, so it is left as it is
+        if (valid_size < file.size() && !IsTornTail(file.data() + valid_size, file.size() - valid_size)) {
+            throw std::runtime_error(path_ + " is damaged at offset " + std::to_string(valid_size));
+        }
+    }
+    // A torn record is cut off; new records must follow the last complete one
+    if (valid_size < static_cast<size_t>(status.st_size)
+        && (ftruncate(descriptor_, valid_size) != 0 || fsync(descriptor_) != 0)) {
+        throw std::runtime_error("Cannot write " + path_);
+    }
+    return record_count;
+}
+
+uint64_t WriteAheadLog::AppendAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    std::lock_guard guard(mutex_);
+    const size_t record_begin = buffer_.size();
+    buffer_.resize(record_begin + RECORD_HEADER_SIZE);
+    PutValue(buffer_, LogRecord::Type::ADD_DOCUMENT);
+    PutValue(buffer_, static_cast<int32_t>(document_id));
+    PutValue(buffer_, static_cast<int32_t>(status));
+    PutValue(buffer_, static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        PutValue(buffer_, static_cast<int32_t>(rating));
+    }
+    PutValue(buffer_, static_cast<uint32_t>(document.size()));
+    buffer_.append(document);
+    return FinishRecord(record_begin);
+}
+
+uint64_t WriteAheadLog::AppendRemoveDocument(int document_id) {
+    std::lock_guard guard(mutex_);
+    const size_t record_begin = buffer_.size();
+    buffer_.resize(record_begin + RECORD_HEADER_SIZE);
+    PutValue(buffer_, LogRecord::Type::REMOVE_DOCUMENT);
+    PutValue(buffer_, static_cast<int32_t>(document_id));
+    return FinishRecord(record_begin);
+}
+
+uint64_t WriteAheadLog::FinishRecord(size_t record_begin) {
+    const uint8_t* payload = reinterpret_cast<const uint8_t*>(buffer_.data()) + record_begin + RECORD_HEADER_SIZE;
+    const uint32_t payload_size = static_cast<uint32_t>(buffer_.size() - record_begin - RECORD_HEADER_SIZE);
+    const uint32_t checksum = ComputeChecksum(payload, payload_size);
+    std::memcpy(buffer_.data() + record_begin, &payload_size, sizeof(payload_size));
+    std::memcpy(buffer_.data() + record_begin + sizeof(payload_size), &checksum, sizeof(checksum));
+    return ++appended_sequence_;
+}
+
+void WriteAheadLog::Commit(uint64_t sequence) {
+    std::unique_lock lock(mutex_);
+    const bool sync = sequence > synced_sequence_ && appended_sequence_ - synced_sequence_ >= options_.sync_batch_size;
+    Flush(lock, sequence, sync);
+}
+
+void WriteAheadLog::Sync() {
+    std::unique_lock lock(mutex_);
+    Flush(lock, appended_sequence_, true);
+}
+
+void WriteAheadLog::Truncate() {
+    std::unique_lock lock(mutex_);
+    flushed_.wait(lock, [this] {
+        return !flushing_;
+    });
+    buffer_.clear();
+    written_sequence_ = synced_sequence_ = appended_sequence_;
+    if (ftruncate(descriptor_, sizeof(LOG_MAGIC)) != 0 || fsync(descriptor_) != 0) {
+        failed_ = true;
+        throw std::runtime_error("Cannot write " + path_);
+    }
+}
+
+void WriteAheadLog::Flush(std::unique_lock<std::mutex>& lock, uint64_t sequence, bool sync) {
+    while (written_sequence_ < sequence || (sync && synced_sequence_ < sequence)) {
+        if (failed_) {
+            throw std::runtime_error("Cannot write " + path_);
+        }
+        if (flushing_) {
+            flushed_.wait(lock);
+            continue;
+        }
+        // This thread writes the records of every thread waiting so far
+        flushing_ = true;
+        spare_buffer_.clear();
+        spare_buffer_.swap(buffer_);
+        const uint64_t target = appended_sequence_;
+        lock.unlock();
+        const bool written = WriteAll(descriptor_, spare_buffer_) && (!sync || fdatasync(descriptor_) == 0);
+        lock.lock();
+        flushing_ = false;
+        if (written) {
+            written_sequence_ = target;
+            if (sync) {
+                synced_sequence_ = target;
+            }
+        } else {
+            failed_ = true;
+        }
+        flushed_.notify_all();
+    }
+}
+
+void WriteAheadLog::RunSyncThread() {
+    std::unique_lock lock(mutex_);
+    while (!stop_requested_.wait_for(lock, options_.sync_interval, [this] {
+        return stopping_;
+    })) {
+        try {
+            Flush(lock, appended_sequence_, true);
+        } catch (const std::runtime_error&) {
+            // The next Commit reports it
+        }
+    }
+}
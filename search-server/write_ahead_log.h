@@ -0,0 +1,104 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "document.h"
+
+// Records handed to a replay callback at a time
+const size_t LOG_REPLAY_BATCH_SIZE = 16384;
+
+struct WriteAheadLogOptions {
+    // Every commit hands the record to the operating system, so it survives a
+    // crash of the process. fsync, which makes it survive a power loss, runs
+    // once this many records are waiting for it; 1 syncs on every commit.
+    size_t sync_batch_size = 1;
+    // If positive, a background thread also syncs waiting records this often,
+    // which bounds how long a record can stay unsynced
+    std::chrono::milliseconds sync_interval{0};
+};
+
+// One change of the index as it was logged
+struct LogRecord {
+    enum class Type : uint8_t {
+        ADD_DOCUMENT = 1,
+        REMOVE_DOCUMENT = 2,
+    };
+
+    Type type;
+    int document_id;
+    // Only for ADD_DOCUMENT
+    DocumentStatus status;
+    std::vector<int> ratings;
+    std::string_view text;
+};
+
+// Append-only log of index changes. Each record carries its own checksum, so
+// a record torn by a crash ends the log instead of corrupting it.
+//
+// Commits from several threads are grouped: while one thread writes and syncs,
+// the others queue their records, and the next write covers all of them.
+class WriteAheadLog {
+public:
+    // Opens the log at `path`, creating it if it does not exist
+    explicit WriteAheadLog(const std::string& path, WriteAheadLogOptions options = {});
+    // Syncs the records that are still waiting
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Calls apply(const std::vector<LogRecord>&) for the logged records in
+    // order, in batches of up to LOG_REPLAY_BATCH_SIZE; texts are valid only
+    // during the call. A torn record at the end is cut off. A damaged record
+    // with intact data after it throws std::runtime_error once the records
+    // before it are applied, and the file is left untouched. Returns the
+    // number of records. Must run before anything is appended.
+    size_t Replay(const std::function<void(const std::vector<LogRecord>&)>& apply);
+
+    // Queue a record and return its sequence number for Commit
+    uint64_t AppendAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    uint64_t AppendRemoveDocument(int document_id);
+
+    // Returns once record `sequence` and all before it are written, and synced
+    // as WriteAheadLogOptions asks. Throws std::runtime_error if writing fails.
+    void Commit(uint64_t sequence);
+    // Writes and syncs every queued record
+    void Sync();
+
+    // Drops every record, for when a snapshot already holds their changes
+    void Truncate();
+
+private:
+    std::string path_;
+    WriteAheadLogOptions options_;
+    int descriptor_ = -1;
+
+    std::mutex mutex_;
+    std::condition_variable flushed_;
+    // Encoded records not yet handed to the operating system
+    std::string buffer_;
+    // Records being written by the flushing thread; swapped with buffer_ to keep both allocations
+    std::string spare_buffer_;
+    uint64_t appended_sequence_ = 0;
+    uint64_t written_sequence_ = 0;
+    uint64_t synced_sequence_ = 0;
+    // Set while one thread writes on behalf of all
+    bool flushing_ = false;
+    bool failed_ = false;
+
+    std::thread sync_thread_;
+    std::condition_variable stop_requested_;
+    bool stopping_ = false;
+
+    uint64_t FinishRecord(size_t record_begin);
+    // Writes, and syncs if `sync`, everything up to `sequence`
+    void Flush(std::unique_lock<std::mutex>& lock, uint64_t sequence, bool sync);
+    void RunSyncThread();
+};